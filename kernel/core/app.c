@@ -0,0 +1,370 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include "vmac.h"
+/*
+ * Applications: netlink port owning each encoding, so several processes can use
+ * V-MAC on one node. Sending data (or an announcement) for an encoding makes a
+ * process its producer, which receives interests, pressure events and transmit
+ * completion reports for it. Sending an interest (or configuring object mode)
+ * makes it the consumer, which receives data frames and objects. Anything
+ * else, or frames of encodings nobody claimed (e.g. overheard), goes to the
+ * default port. Each role has one process: while it is bound, other processes
+ * claiming the role are refused (bind_refused) and keep sending, but do not
+ * receive for the encoding. Bindings of a process go away when its socket is closed. A port
+ * is either a raw V-MAC netlink socket or a generic netlink one (genl bits),
+ * which get differently formatted messages.
+ */
+
+struct vmac_app
+{
+    struct hlist_node node;
+    struct rcu_head rcu;
+    u64 enc;
+    u32 pub; /* producer port, 0 = none */
+    u32 sub; /* consumer port, 0 = none */
+    u8 genl; /* APP_GENL_PUB/APP_GENL_SUB: port is generic netlink */
+};
+
+#define APP_GENL_PUB 0x01
+#define APP_GENL_SUB 0x02
+
+/* port that bound an encoding or registered, so closing other sockets costs one lookup */
+struct app_port
+{
+    struct hlist_node node;
+    struct rcu_head rcu;
+    u32 portid;
+    u8 genl;
+};
+
+static DEFINE_HASHTABLE(app_enc, APP_HASH_BITS);
+static DEFINE_HASHTABLE(app_ports, APP_HASH_BITS);
+static DEFINE_SPINLOCK(app_lock); /* writers of app_enc and app_ports, default port */
+static u32 app_default; /* port of frames nobody claimed, 0 = none */
+static u8 app_default_genl;
+static bool app_ready; /* socket release notifier registered */
+
+static struct vmac_app* app_find(u64 enc)
+{
+    struct vmac_app *a;
+    hash_for_each_possible_rcu(app_enc, a, node, enc)
+    {
+        if (a->enc == enc)
+            return a;
+    }
+    return NULL;
+}
+
+static struct app_port* app_port_find(u32 portid, u8 genl)
+{
+    struct app_port *p;
+    hash_for_each_possible_rcu(app_ports, p, node, portid)
+    {
+        if (p->portid == portid && !p->genl == !genl)
+            return p;
+    }
+    return NULL;
+}
+
+/**
+ * @brief      Remember port, taking preallocated entry if port is new. Caller holds app_lock.
+ *
+ * @return     false if port is new and no entry was preallocated
+ */
+static bool app_port_add(u32 portid, u8 genl, struct app_port **n)
+{
+    if (app_port_find(portid, genl))
+        return true;
+    if (!*n)
+        return false;
+    (*n)->portid = portid;
+    (*n)->genl = genl;
+    hash_add_rcu(app_ports, &(*n)->node, portid);
+    *n = NULL;
+    return true;
+}
+
+/* types delivered to producer of encoding, other types go to its consumer */
+static bool app_pub_type(u8 type)
+{
+    return type == VMAC_HDR_INTEREST || type == VMAC_PRESSURE || type == VMAC_TXDONE;
+}
+
+/**
+ * @brief      Bind encoding to sending process (called by nl_recv in process context)
+ *
+ * @param[in]  enc     The encoding
+ * @param[in]  type    type of message process sent for encoding
+ * @param[in]  portid  netlink port of process
+ * @param[in]  genl    port is generic netlink
+ *
+ * @code{.unparsed}
+ *  If interest or object mode config: process becomes consumer of encoding
+ *  else if data, bulk, announcement, injected frame or completion report config: process becomes producer
+ *  else return
+ *  If bound already to same port and transport
+ *   return //hot path, no lock taken
+ *  End If
+ *  If role bound to another port (and closed sockets release bindings)
+ *   count refused binding, return
+ *  End If
+ *  lock table
+ *  remember port, create entry if not present
+ *  set producer or consumer port and transport, unless bound to another port meanwhile
+ *  unlock table
+ * @endcode
+ */
+void vmac_app_bind(u64 enc, u8 type, u32 portid, u8 genl)
+{
+    struct vmac_app *a, *n = NULL;
+    struct app_port *p;
+    bool pub, refused = false;
+    u32 cur;
+    u8 bit;
+    if (type == VMAC_HDR_INTEREST || type == VMAC_CONFIG)
+        pub = false;
+    else if (type == VMAC_HDR_DATA || type == VMAC_BULK || type == VMAC_HDR_ANOUNCMENT || type == VMAC_HDR_INJECTED || type == VMAC_TXDONE)
+        pub = true;
+    else
+        return;
+    bit = pub ? APP_GENL_PUB : APP_GENL_SUB;
+    rcu_read_lock();
+    a = app_find(enc);
+    cur = a ? (pub ? READ_ONCE(a->pub) : READ_ONCE(a->sub)) : 0;
+    if (cur == portid && a && !(READ_ONCE(a->genl) & bit) == !genl)
+    {
+        rcu_read_unlock();
+        return;
+    }
+    rcu_read_unlock();
+    if (cur && cur != portid && app_ready)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_BIND_REFUSED);
+        return;
+    }
+    n = kzalloc(sizeof(struct vmac_app), GFP_KERNEL);
+    p = kzalloc(sizeof(struct app_port), GFP_KERNEL);
+    spin_lock_bh(&app_lock);
+    a = app_find(enc);
+    if (!app_port_add(portid, genl, &p))
+        a = NULL; /* binding could never be released */
+    else if (!a && n)
+    {
+        a = n;
+        n = NULL;
+        a->enc = enc;
+        hash_add_rcu(app_enc, &a->node, enc);
+    }
+    if (a)
+    {
+        cur = pub ? a->pub : a->sub;
+        if (cur && cur != portid && app_ready)
+            refused = true;
+        else if (pub)
+            WRITE_ONCE(a->pub, portid);
+        else
+            WRITE_ONCE(a->sub, portid);
+        if (!refused)
+            WRITE_ONCE(a->genl, genl ? a->genl | bit : a->genl & ~bit);
+    }
+    spin_unlock_bh(&app_lock);
+    kfree(n);
+    kfree(p);
+    if (!a)
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+    else if (refused)
+        vmac_stat_inc(NULL, VMAC_STAT_BIND_REFUSED);
+}
+
+/**
+ * @brief      Port to deliver message of encoding to (any context)
+ *
+ * @param[in]  enc   The encoding, 0 for frames not belonging to an encoding
+ * @param[in]  type  The frame or event type
+ * @param[out] genl  set if port is generic netlink
+ *
+ * @return     netlink port, 0 if no process to deliver to
+ */
+u32 vmac_app_port(u64 enc, u8 type, u8 *genl)
+{
+    struct vmac_app *a;
+    u32 port = 0;
+    u8 bits = 0;
+    if (enc)
+    {
+        rcu_read_lock();
+        a = app_find(enc);
+        if (a)
+        {
+            if (app_pub_type(type))
+                port = READ_ONCE(a->pub);
+            else
+                port = READ_ONCE(a->sub);
+            bits = READ_ONCE(a->genl) & (app_pub_type(type) ? APP_GENL_PUB : APP_GENL_SUB);
+        }
+        rcu_read_unlock();
+    }
+    if (!port)
+    {
+        spin_lock_bh(&app_lock);
+        port = app_default;
+        bits = app_default_genl;
+        spin_unlock_bh(&app_lock);
+    }
+    *genl = bits != 0;
+    return port;
+}
+
+/**
+ * @brief      Process registered (type 255 or VMAC_CMD_REGISTER): becomes default port unless another one is
+ */
+void vmac_app_register(u32 portid, u8 genl)
+{
+    struct app_port *p = kzalloc(sizeof(struct app_port), GFP_KERNEL);
+    spin_lock_bh(&app_lock);
+    if (!app_default && app_port_add(portid, genl, &p))
+    {
+        app_default = portid;
+        app_default_genl = genl;
+    }
+    spin_unlock_bh(&app_lock);
+    kfree(p);
+}
+
+/**
+ * @brief      Claim or give up default port (VMAC_CONFIG_DEFAULT)
+ *
+ * @param[in]  on      nonzero to claim, 0 to give up if held
+ */
+void vmac_app_default(u32 portid, u8 genl, u8 on)
+{
+    struct app_port *p = on ? kzalloc(sizeof(struct app_port), GFP_KERNEL) : NULL;
+    spin_lock_bh(&app_lock);
+    if (on && !app_port_add(portid, genl, &p))
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+    else if (on)
+    {
+        app_default = portid;
+        app_default_genl = genl;
+    }
+    else if (app_default == portid && app_default_genl == genl)
+        app_default = 0;
+    spin_unlock_bh(&app_lock);
+    kfree(p);
+}
+
+/**
+ * @brief      Drop bindings of closed socket, or of process that announced its
+ * exit (type 254)
+ *
+ * @code{.unparsed}
+ *  If port never bound or registered
+ *   return //most sockets closed in the system, no lock taken
+ *  End If
+ *  lock table
+ *  forget port
+ *  for each entry
+ *   clear producer and consumer port if they are the closed port (same transport)
+ *   free entry after RCU grace period if no port left
+ *  End For
+ *  clear default port if it is the closed port
+ *  unlock table
+ * @endcode
+ */
+void app_release(u32 portid, u8 genl)
+{
+    struct vmac_app *a;
+    struct app_port *p;
+    struct hlist_node *tmp;
+    int bkt;
+    rcu_read_lock();
+    p = app_port_find(portid, genl);
+    rcu_read_unlock();
+    if (!p)
+        return;
+    spin_lock_bh(&app_lock);
+    p = app_port_find(portid, genl);
+    if (!p)
+    {
+        spin_unlock_bh(&app_lock);
+        return;
+    }
+    hash_del_rcu(&p->node);
+    kfree_rcu(p, rcu);
+    hash_for_each_safe(app_enc, bkt, tmp, a, node)
+    {
+        if (a->pub == portid && !(a->genl & APP_GENL_PUB) == !genl)
+            WRITE_ONCE(a->pub, 0);
+        if (a->sub == portid && !(a->genl & APP_GENL_SUB) == !genl)
+            WRITE_ONCE(a->sub, 0);
+        if (!a->pub && !a->sub)
+        {
+            hash_del_rcu(&a->node);
+            kfree_rcu(a, rcu);
+        }
+    }
+    if (app_default == portid && app_default_genl == genl)
+        app_default = 0;
+    spin_unlock_bh(&app_lock);
+}
+
+static int app_notify(struct notifier_block *nb, unsigned long event, void *ptr)
+{
+    struct netlink_notify *n = ptr;
+    if (event != NETLINK_URELEASE || !net_eq(n->net, &init_net))
+        return NOTIFY_DONE;
+    if (n->protocol == VMAC_USER)
+        app_release(n->portid, 0);
+    else if (n->protocol == NETLINK_GENERIC)
+        app_release(n->portid, 1);
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block app_nb = {
+    .notifier_call = app_notify,
+};
+
+int app_init(void)
+{
+    int ret = netlink_register_notifier(&app_nb);
+    app_ready = !ret;
+    return ret;
+}
+
+/**
+ * @brief      Stop socket release notifications and free all bindings
+ */
+void app_stop(void)
+{
+    struct vmac_app *a;
+    struct app_port *p;
+    struct hlist_node *tmp;
+    int bkt;
+    if (app_ready)
+        netlink_unregister_notifier(&app_nb);
+    app_ready = false;
+    spin_lock_bh(&app_lock);
+    hash_for_each_safe(app_enc, bkt, tmp, a, node)
+    {
+        hash_del_rcu(&a->node);
+        kfree_rcu(a, rcu);
+    }
+    hash_for_each_safe(app_ports, bkt, tmp, p, node)
+    {
+        hash_del_rcu(&p->node);
+        kfree_rcu(p, rcu);
+    }
+    app_default = 0;
+    spin_unlock_bh(&app_lock);
+}
@@ -0,0 +1,23 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#define APP_HASH_BITS 8
+
+/* application (netlink port) table functions */
+int app_init(void);
+void app_stop(void);
+void vmac_app_register(u32 portid, u8 genl);
+void vmac_app_default(u32 portid, u8 genl, u8 on);
+void vmac_app_bind(u64 enc, u8 type, u32 portid, u8 genl);
+void app_release(u32 portid, u8 genl);
+u32 vmac_app_port(u64 enc, u8 type, u8 *genl);
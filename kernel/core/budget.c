@@ -0,0 +1,185 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+#include "vmac.h"
+
+static unsigned int vmac_retx_budget_kb = 65536;
+module_param(vmac_retx_budget_kb, uint, 0644);
+MODULE_PARM_DESC(vmac_retx_budget_kb, "Memory (KB) all retransmission buffers may hold, 0 = unlimited");
+
+static atomic_long_t retx_bytes = ATOMIC_LONG_INIT(0);
+static atomic_t retx_evicted = ATOMIC_INIT(0); /* evicted since last pressure report */
+static unsigned long lastreport;
+/* encoding_tx entries ordered by last DACK heard, least recent first */
+static LIST_HEAD(retx_lru);
+static DEFINE_SPINLOCK(retx_lrulok);
+
+/**
+ * @brief      add new transmission entry to LRU (as most recent)
+ */
+void budget_track(struct encoding_tx *vmact)
+{
+    spin_lock_bh(&retx_lrulok);
+    list_add_tail(&vmact->lru, &retx_lru);
+    spin_unlock_bh(&retx_lrulok);
+}
+
+/**
+ * @brief      drop transmission entry from LRU, must be called before entry is
+ * scheduled to be freed
+ */
+void budget_untrack(struct encoding_tx *vmact)
+{
+    spin_lock_bh(&retx_lrulok);
+    list_del_init(&vmact->lru);
+    spin_unlock_bh(&retx_lrulok);
+}
+
+/**
+ * @brief      mark transmission entry as DACKed now (move to LRU tail)
+ */
+void budget_touch(struct encoding_tx *vmact)
+{
+    spin_lock_bh(&retx_lrulok);
+    if (!list_empty(&vmact->lru))
+        list_move_tail(&vmact->lru, &retx_lru);
+    spin_unlock_bh(&retx_lrulok);
+}
+
+/**
+ * @brief      account frame stored into retransmission buffer
+ */
+void budget_charge(struct sk_buff *skb)
+{
+    if (skb)
+        atomic_long_add(skb->truesize, &retx_bytes);
+}
+
+/**
+ * @brief      free frame taken out of retransmission buffer and release its accounting
+ */
+void retx_free(struct sk_buff *skb)
+{
+    if (!skb)
+        return;
+    atomic_long_sub(skb->truesize, &retx_bytes);
+    kfree_skb(skb);
+}
+
+/**
+ * @brief      evict oldest buffered frames of entry until usage is within budget
+ *
+ * @param      vmact   The transmission entry
+ * @param[in]  budget  The budget in bytes
+ *
+ * @return     frames evicted
+ *
+ * @code{.unparsed}
+ *  lock entry retransmission buffer
+ *  start from oldest sequence still within window (or first not yet evicted)
+ *  while usage above budget and sequence not yet sent
+ *   free buffered frame of sequence if any
+ *   increment sequence
+ *  End While
+ *  remember first sequence not evicted
+ *  unlock entry retransmission buffer
+ * @endcode
+ */
+static int budget_evict(struct encoding_tx *vmact, long budget)
+{
+    struct retx_chunk *chunk;
+    struct sk_buff *skb;
+    u16 s, seq;
+    int n = 0;
+    spin_lock_bh(&vmact->buflock);
+    seq = vmact->seq;
+    s = seq - WINDOW_TX;
+    if (seq_after(vmact->evict_seq, s) && !seq_after(vmact->evict_seq, seq))
+        s = vmact->evict_seq;
+    while (s != seq && atomic_long_read(&retx_bytes) > budget)
+    {
+        chunk = retx_chunk(vmact, s);
+        if (chunk && chunk->buf[s % RETX_CHUNK])
+        {
+            skb = chunk->buf[s % RETX_CHUNK];
+            chunk->buf[s % RETX_CHUNK] = NULL;
+            retx_free(skb);
+            n++;
+        }
+        s++;
+    }
+    vmact->evict_seq = s;
+    spin_unlock_bh(&vmact->buflock);
+    return n;
+}
+
+/**
+ * @brief      Keep retransmission buffers within vmac_retx_budget_kb and report
+ * pressure to userspace.
+ *
+ * @code{.unparsed}
+ *  If usage is above budget
+ *   lock LRU
+ *   for each entry from least recently DACKed
+ *    evict oldest frames of entry until within budget
+ *    stop if within budget
+ *   End For
+ *   unlock LRU
+ *  End If
+ *  If usage passed high watermark or frames were evicted, and last report is older than BUDGET_REPORT_MS
+ *   send pressure event (usage, budget, evicted frames) naming encoding evicted last
+ *  End If
+ * @endcode
+ */
+void budget_enforce(void)
+{
+    struct encoding_tx *vmact;
+    struct vmac_pressure p;
+    long budget = (long)READ_ONCE(vmac_retx_budget_kb) << 10;
+    long used;
+    u64 victim = 0;
+    u32 val;
+    int n;
+    if (!budget)
+        return;
+    if (atomic_long_read(&retx_bytes) > budget)
+    {
+        spin_lock_bh(&retx_lrulok);
+        list_for_each_entry(vmact, &retx_lru, lru)
+        {
+            n = budget_evict(vmact, budget);
+            if (n)
+            {
+                atomic_add(n, &retx_evicted);
+                vmac_stat_add(vmact->stats, VMAC_STAT_RETX_EVICTED, n);
+                victim = vmact->key;
+            }
+            if (atomic_long_read(&retx_bytes) <= budget)
+                break;
+        }
+        spin_unlock_bh(&retx_lrulok);
+    }
+    used = atomic_long_read(&retx_bytes);
+    if ((used * BUDGET_HIGH_DEN > budget * BUDGET_HIGH_NUM || victim)
+        && time_after(jiffies, READ_ONCE(lastreport) + msecs_to_jiffies(BUDGET_REPORT_MS)))
+    {
+        WRITE_ONCE(lastreport, jiffies);
+        val = used >> 10;
+        memcpy(&p.used_kb[0], &val, 4);
+        val = budget >> 10;
+        memcpy(&p.budget_kb[0], &val, 4);
+        val = atomic_xchg(&retx_evicted, 0);
+        memcpy(&p.evicted[0], &val, 4);
+        vmac_nl_event(VMAC_PRESSURE, victim, &p, sizeof(struct vmac_pressure));
+    }
+}
@@ -0,0 +1,29 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+
+/* Defines ********************************************************************/
+#define BUDGET_HIGH_NUM 7   /* pressure reported once usage passes 7/8 of budget */
+#define BUDGET_HIGH_DEN 8
+#define BUDGET_REPORT_MS 100 /* minimum gap between pressure reports */
+
+struct encoding_tx;
+struct sk_buff;
+
+/* retransmission memory budget functions */
+void budget_track(struct encoding_tx *vmact);
+void budget_untrack(struct encoding_tx *vmact);
+void budget_touch(struct encoding_tx *vmact);
+void budget_charge(struct sk_buff *skb);
+void retx_free(struct sk_buff *skb);
+void budget_enforce(void);
@@ -16,135 +16,157 @@
 /* cleanup */
 #define DEBUG_MO
 
+static unsigned int vmac_enc_timeout_ms = 30000;
+module_param(vmac_enc_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(vmac_enc_timeout_ms, "Idle time (ms) before an encoding entry is freed");
+
+static unsigned int vmac_gc_interval_ms = 1000;
+module_param(vmac_gc_interval_ms, uint, 0644);
+MODULE_PARM_DESC(vmac_gc_interval_ms, "Period (ms) of idle encoding sweep");
+
+static void gc_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gc_work, gc_work_fn);
+
+static void free_rx_rcu(struct rcu_head *head)
+{
+    free_rx(container_of(head, struct encoding_rx, rcu));
+}
+
+static void free_tx_rcu(struct rcu_head *head)
+{
+    #ifdef DEBUG_MO
+        printk(KERN_INFO "VMAC_CLEAN: tx emptying buffer\n");
+    #endif
+    free_tx(container_of(head, struct encoding_tx, rcu));
+}
+
+/**
+ * @brief      check whether entry has been idle past its timeout
+ *
+ * @param[in]  last     jiffies of last activity
+ * @param[in]  timeout  entry timeout in jiffies, 0 for module default
+ */
+static bool idle(unsigned long last, u32 timeout)
+{
+    if (!timeout)
+        timeout = msecs_to_jiffies(READ_ONCE(vmac_enc_timeout_ms));
+    return time_after(jiffies, last + timeout);
+}
+
 /**
- * @brief      Clean up encoding from encoding table (occurs per encoding timeout)
+ * @brief      Free receiving entry if idle (called by GC sweep within RCU read section)
+ *
+ * @param      vmacr  The receiving entry
  *
- * @param[in]  data  The data: pointer to encoding cleanup struct
- * 
  * Pseudo Code
- * 
+ *
  * @code{.unparsed}
- * check type of struct (i.e. tx or rx)
- * If type of cleaning is for receiving struct
- *  search for encoding at rx table (sanity check)
- *  If not found
+ *  If entry not idle past timeout
  *      return
  *  End If
- *  remove from hastable
+ *  remove from hashtable, return if already removed
+ *  cancel pending DACK timer and drop from pending DACK list
  *  free DACK struct if any left in queue not sent
- *  free rx_struct
- * else (i.e. type must be TX_ENC)
- *  search for encoding at tx table (sanity check)
- *  if not found
- *      return
- *  End If
- *  for i = 0 to either end of retransmission buffer size or latest sequence number transmitted (whichever smaller)
- *      free retransmission buffer frame
- *  End for
- *  remove from hastable
- *  free rx_struct
- *  @endcode
+ *  deliver frames held for in-order delivery, free reorder state
+ *  free rx_struct after RCU grace period (lookups may still hold it)
+ * @endcode
  */
-
-void process (struct enc_cleanup* clean)
+static void expire_rx(struct encoding_rx *vmacr, void *arg)
 {
-    struct encoding_rx* vmacr;
-    struct encoding_tx* vmact;
-    int i;
-    if(clean->type == CLEAN_ENC_RX)
-    {
-        #ifdef DEBUG_MO
-            printk(KERN_INFO "CLEAN: starting process \n");
-        #endif
-        vmacr= find_rx(RX_TABLE, clean->enc);
-        if (!vmacr || vmacr == NULL)
-        {
-            return;
-        }
-        
-        printk(KERN_INFO "CLEAN: removing element\n");        
-     /* if(vmacr->dac_info.dack)
-        kfree_skb(vmacr->dac_info.dack); mo */
-        hash_del(&vmacr->node);
-        vfree(vmacr);
-    }
-    else /* must be CLEAN_ENC_TX*/
-    {
-        vmact = find_tx(TX_TABLE, clean->enc);
-        {
-
-        }
-        if (!vmact || vmact == NULL)
-        {
-            return;
-        }
-        #ifdef DEBUG_MO
-            printk(KERN_INFO "VMAC_CLEAN: tx emptying buffer\n");
-        #endif
-        for(i = 0; i < (vmact->seq < WINDOW_TX ? vmact->seq : WINDOW_TX); i++)
-        {
-            if(vmact->retransmission_buffer[i])
-               kfree_skb(vmact->retransmission_buffer[i]);
-        }
-        hash_del(&vmact->node);
-        vfree(vmact);
-    }
+    if (!idle(READ_ONCE(vmacr->lastactive), READ_ONCE(vmacr->timeout)) || del_rx(vmacr))
+        return;
+    #ifdef DEBUG_MO
+        printk(KERN_INFO "CLEAN: removing element\n");
+    #endif
+    dack_forget(vmacr);
+    reorder_forget(vmacr);
+    call_rcu(&vmacr->rcu, free_rx_rcu);
 }
+
 /**
- * @brief     clean up for receiving struct called by timer
+ * @brief      Free transmission entry if idle (called by GC sweep within RCU read section)
+ *
+ * @param      vmact  The transmission entry
  *
- * @param      t     time struct passing pointer to receving struct
- * 
  * Pseudo Code
+ *
  * @code{.unparsed}
- * Set type of struct to receiving struct
- * Call process function to handle emptying memory within.
+ *  If entry not idle past timeout
+ *      return
+ *  End If
+ *  remove from hashtable, return if already removed
+ *  remove from retransmission budget LRU
+ *  after RCU grace period:
+ *      for each allocated retransmission chunk
+ *          free buffered frames (releasing budget) and chunk
+ *      End for
+ *      free tx_struct
  * @endcode
  */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
-void __cleanup_rx(struct timer_list *t)
+static void expire_tx(struct encoding_tx *vmact, void *arg)
 {
-    struct encoding_rx* vmacr = from_timer(vmacr, t, enc_timeout);
-    if (vmacr)
-    {
-        #ifdef DEBUG_VMAC
-            printk(KERN_INFO"VMAC_CLEAN: rx cleaning started \n");
-        #endif
-        vmacr->clean.type = CLEAN_ENC_RX;
-        process(&vmacr->clean);
-    }
-    
+    if (!idle(READ_ONCE(vmact->lastactive), READ_ONCE(vmact->timeout)) || del_tx(vmact))
+        return;
+    budget_untrack(vmact);
+    call_rcu(&vmact->rcu, free_tx_rcu);
 }
+
 /**
- * @brief      clean up for transmission struct called by timer
+ * @brief      Periodic sweep over encoding tables freeing idle entries. Hot path
+ * only stamps lastactive, so no timer is touched per frame.
  *
- * @param      t     time struct passing pointer to receving struct
- * 
- * Pseudo Code
- * 
- * @code{.unparsed}
- * Set type of struct to transmission struct
- * Call process function to handle emptying memory within.
- * @endcode
+ * @param      work  The work
  */
-void __cleanup_tx(struct timer_list *t)
-{    
-    struct encoding_tx* vmact = from_timer(vmact, t, enc_timeout);
-    if (vmact)
-    {
-        vmact->clean.type = CLEAN_ENC_TX;
-        process(&vmact->clean);            
-    }
+static void gc_work_fn(struct work_struct *work)
+{
+    walk_rx(expire_rx, NULL);
+    walk_tx(expire_tx, NULL);
+    schedule_delayed_work(&gc_work, msecs_to_jiffies(max(READ_ONCE(vmac_gc_interval_ms), 10U)));
+}
+
+void vmac_gc_start(void)
+{
+    schedule_delayed_work(&gc_work, msecs_to_jiffies(max(READ_ONCE(vmac_gc_interval_ms), 10U)));
+}
+
+void vmac_gc_stop(void)
+{
+    cancel_delayed_work_sync(&gc_work);
 }
+
 /**
- * @brief      cleanup struct for old kernel 4.18.0, same as cleanup_rx and tx.
+ * @brief      Set idle timeout of encoding (VMAC_CONFIG_TIMEOUT)
+ *
+ * @param[in]  enc   The encoding, 0 sets module default for all encodings without own timeout
+ * @param[in]  ms    timeout in ms, 0 reverts encoding to module default
  *
- * @param[in]  data  pointer to clean struct in encoding
+ * Pseudo Code
+ *
+ * @code{.unparsed}
+ *  If encoding is 0
+ *      set module default timeout (ignored if 0)
+ *      return
+ *  End If
+ *  set timeout of rx and tx entries of encoding if they exist
+ * @endcode
  */
-#else
-void __cleanup(unsigned long data)
+void vmac_set_timeout(u64 enc, u32 ms)
 {
-    struct enc_cleanup* clean=(struct enc_cleanup*)data;
-    process(clean);
+    struct encoding_rx* vmacr;
+    struct encoding_tx* vmact;
+    u32 timeout = ms ? max_t(unsigned long, msecs_to_jiffies(ms), 1) : 0;
+    if (!enc)
+    {
+        if (ms)
+            WRITE_ONCE(vmac_enc_timeout_ms, ms);
+        return;
+    }
+    rcu_read_lock();
+    vmacr = find_rx(RX_TABLE, enc);
+    if (vmacr)
+        WRITE_ONCE(vmacr->timeout, timeout);
+    vmact = find_tx(TX_TABLE, enc);
+    if (vmact)
+        WRITE_ONCE(vmact->timeout, timeout);
+    rcu_read_unlock();
 }
-#endif
@@ -12,9 +12,6 @@
 * 
 */
 #include <linux/version.h>
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4,18,0)
-void __cleanup(unsigned long data);
-#else
-void __cleanup_rx(struct timer_list *t);
-void __cleanup_tx(struct timer_list *t);
-#endif
+void vmac_gc_start(void);
+void vmac_gc_stop(void);
+void vmac_set_timeout(u64 enc, u32 ms);
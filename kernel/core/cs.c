@@ -0,0 +1,358 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+#include "vmac.h"
+/*
+ * Content store: received data frames kept by (encoding, sequence) so that any
+ * consumer holding a frame can answer DACK holes of its peers, taking repair
+ * load off the producer.
+ */
+
+static unsigned int vmac_cs_kb = 0;
+module_param(vmac_cs_kb, uint, 0644);
+MODULE_PARM_DESC(vmac_cs_kb, "Memory (KB) of received frames cached to repair peers, 0 = content store off");
+
+static unsigned int vmac_cs_age_ms = 1000;
+module_param(vmac_cs_age_ms, uint, 0644);
+MODULE_PARM_DESC(vmac_cs_age_ms, "Time (ms) a cached frame may repair peers, older frames may belong to a restarted stream");
+
+struct cs_key
+{
+    u64 enc;
+    u32 seq;
+};
+
+struct cs_entry
+{
+    struct cs_key key;
+    struct sk_buff *skb; /* vmac header, data header and payload, as sent by producer */
+    unsigned long stored; /* jiffies */
+    unsigned long lastsent; /* jiffies of last repair from this node */
+    ktime_t due; /* repair time while pending */
+    u8 pending;
+    struct list_head lru; /* least recently stored/requested first */
+    struct list_head pend;
+    struct rhash_head node;
+    struct rcu_head rcu;
+};
+
+static const struct rhashtable_params cs_params = {
+    .key_len = offsetofend(struct cs_key, seq), /* padding is not hashed */
+    .key_offset = offsetof(struct cs_entry, key),
+    .head_offset = offsetof(struct cs_entry, node),
+    .automatic_shrinking = true,
+};
+
+static struct rhashtable cs_table;
+static LIST_HEAD(cs_lru);
+static LIST_HEAD(cs_pending);
+static DEFINE_SPINLOCK(cs_lock); /* lru, pending list and cs_bytes */
+static long cs_bytes;
+static struct hrtimer cs_timer;
+static bool cs_ready;
+
+static enum hrtimer_restart cs_repair(struct hrtimer *t);
+
+static void cs_free_rcu(struct rcu_head *head)
+{
+    struct cs_entry *e = container_of(head, struct cs_entry, rcu);
+    kfree_skb(e->skb);
+    kfree(e);
+}
+
+/**
+ * @brief      unlink entry from table, LRU and pending list and free after grace period.
+ * Caller holds cs_lock. LRU node is left empty, lookups still holding the entry
+ * under RCU check it (under cs_lock) before scheduling a repair.
+ */
+static void cs_drop(struct cs_entry *e)
+{
+    rhashtable_remove_fast(&cs_table, &e->node, cs_params);
+    list_del_init(&e->lru);
+    if (e->pending)
+    {
+        list_del(&e->pend);
+        e->pending = 0;
+    }
+    cs_bytes -= e->skb->truesize;
+    call_rcu(&e->rcu, cs_free_rcu);
+}
+
+/* entry too old to repair peers, stream may have restarted or wrapped since */
+static bool cs_aged(const struct cs_entry *e)
+{
+    return time_after(jiffies, e->stored + msecs_to_jiffies(READ_ONCE(vmac_cs_age_ms)));
+}
+
+/**
+ * @brief      Drop cached frame (enc, seq) if any. Caller holds cs_lock.
+ */
+static void cs_drop_key(u64 enc, u16 seq)
+{
+    struct cs_key key = { .enc = enc, .seq = seq };
+    struct cs_entry *e = rhashtable_lookup_fast(&cs_table, &key, cs_params);
+    if (e && !list_empty(&e->lru))
+        cs_drop(e);
+}
+
+/**
+ * @brief      Initialize content store table and repair timer
+ *
+ * @return     0 on success, negative errno otherwise
+ */
+int cs_init(void)
+{
+    int ret = rhashtable_init(&cs_table, &cs_params);
+    if (ret)
+        return ret;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+    hrtimer_setup(&cs_timer, cs_repair, CLOCK_MONOTONIC, CS_TIMER_MODE);
+#else
+    hrtimer_init(&cs_timer, CLOCK_MONOTONIC, CS_TIMER_MODE);
+    cs_timer.function = cs_repair;
+#endif
+    cs_ready = true;
+    return 0;
+}
+
+/**
+ * @brief      Keep copy of newly received data frame
+ *
+ * @param[in]  enc   The encoding
+ * @param[in]  seq   The sequence
+ * @param      skb   received frame, data pointing at vmac data header (vmac header just pulled)
+ *
+ * @code{.unparsed}
+ *  If content store disabled
+ *   return
+ *  copy frame, restore vmac header and strip FCS
+ *  lock content store
+ *  drop frame cached under same sequence (earlier stream) and the one WINDOW behind
+ *  insert into table, add to LRU tail and account size
+ *  while size above limit or LRU head aged
+ *   drop LRU head
+ *  End While
+ *  unlock content store
+ * @endcode
+ */
+void cs_store(u64 enc, u16 seq, struct sk_buff *skb)
+{
+    struct cs_entry *e;
+    long limit = (long)READ_ONCE(vmac_cs_kb) << 10;
+    if (!limit || !cs_ready || skb->len < sizeof(struct vmac_data) + 4)
+        return;
+    e = kzalloc(sizeof(struct cs_entry), GFP_ATOMIC);
+    if (!e)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+        return;
+    }
+    e->skb = skb_copy(skb, GFP_ATOMIC);
+    if (!e->skb)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+        kfree(e);
+        return;
+    }
+    skb_push(e->skb, sizeof(struct vmac_hdr));
+    skb_trim(e->skb, e->skb->len - 4);
+    INIT_LIST_HEAD(&e->lru);
+    INIT_LIST_HEAD(&e->pend);
+    e->key.enc = enc;
+    e->key.seq = seq;
+    e->stored = jiffies;
+    e->lastsent = e->stored - msecs_to_jiffies(CS_RESEND_MS) - 1;
+    rcu_read_lock();
+    spin_lock_bh(&cs_lock);
+    /* cs_stop drained the store meanwhile */
+    if (!cs_ready)
+        goto drop;
+    cs_drop_key(enc, seq);
+    cs_drop_key(enc, seq - WINDOW);
+    if (rhashtable_insert_fast(&cs_table, &e->node, cs_params))
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+        goto drop;
+    }
+    list_add_tail(&e->lru, &cs_lru);
+    cs_bytes += e->skb->truesize;
+    while (!list_empty(&cs_lru))
+    {
+        struct cs_entry *old = list_first_entry(&cs_lru, struct cs_entry, lru);
+        if (cs_bytes <= limit && !cs_aged(old))
+            break;
+        cs_drop(old);
+    }
+    spin_unlock_bh(&cs_lock);
+    rcu_read_unlock();
+    return;
+drop:
+    spin_unlock_bh(&cs_lock);
+    rcu_read_unlock();
+    kfree_skb(e->skb);
+    kfree(e);
+}
+
+/**
+ * @brief      Frame (enc, seq) heard on air: another node repaired it, cancel our pending repair
+ */
+void cs_heard(u64 enc, u16 seq)
+{
+    struct cs_key key = { .enc = enc, .seq = seq };
+    struct cs_entry *e;
+    if (!cs_ready)
+        return;
+    e = rhashtable_lookup_fast(&cs_table, &key, cs_params);
+    if (!e || !READ_ONCE(e->pending))
+        return;
+    spin_lock_bh(&cs_lock);
+    if (e->pending)
+    {
+        list_del(&e->pend);
+        e->pending = 0;
+    }
+    spin_unlock_bh(&cs_lock);
+}
+
+/**
+ * @brief      DACK hole [le, re) heard for encoding we do not produce: schedule
+ * repair of cached frames after hold-off and random backoff.
+ *
+ * @param[in]  enc      The encoding
+ * @param[in]  le       first lost sequence
+ * @param[in]  re       end of lost run (exclusive)
+ * @param      counter  frames scheduled so far for this DACK
+ *
+ * @code{.unparsed}
+ *  for each sequence in hole (at most WINDOW) while less than CS_REPAIR_MAX scheduled
+ *   look up content store
+ *   drop entry if aged, stream may have restarted since
+ *   if cached, not pending, not dropped meanwhile (on LRU) and not repaired by us within CS_RESEND_MS
+ *    set due time to now + hold-off + random backoff
+ *    add to pending list, move to LRU tail
+ *    arm repair timer if due earlier than armed
+ *   End If
+ *  End For
+ * @endcode
+ */
+void cs_request(u64 enc, u16 le, u16 re, int *counter)
+{
+    struct cs_key key = { .enc = enc };
+    struct cs_entry *e;
+    ktime_t due;
+    u32 rnd;
+    if (!READ_ONCE(vmac_cs_kb) || !cs_ready)
+        return;
+    if ((u16)(re - le) > WINDOW)
+        re = le + WINDOW;
+    for (; seq_before(le, re) && *counter < CS_REPAIR_MAX; le++)
+    {
+        key.seq = le;
+        e = rhashtable_lookup_fast(&cs_table, &key, cs_params);
+        if (e && cs_aged(e))
+        {
+            spin_lock_bh(&cs_lock);
+            if (!list_empty(&e->lru))
+                cs_drop(e);
+            spin_unlock_bh(&cs_lock);
+            continue;
+        }
+        if (!e || READ_ONCE(e->pending) || !time_after(jiffies, READ_ONCE(e->lastsent) + msecs_to_jiffies(CS_RESEND_MS)))
+            continue;
+        get_random_bytes(&rnd, sizeof(rnd));
+        due = ktime_add_us(ktime_get(), CS_HOLDOFF_US + rnd % CS_BACKOFF_US);
+        spin_lock_bh(&cs_lock);
+        if (!e->pending && !list_empty(&e->lru))
+        {
+            e->pending = 1;
+            e->due = due;
+            list_add_tail(&e->pend, &cs_pending);
+            list_move_tail(&e->lru, &cs_lru);
+            (*counter)++;
+            if (!hrtimer_is_queued(&cs_timer) || ktime_before(due, hrtimer_get_expires(&cs_timer)))
+                hrtimer_start(&cs_timer, due, CS_TIMER_MODE);
+        }
+        spin_unlock_bh(&cs_lock);
+    }
+}
+
+/**
+ * @brief      Repair timer: send cached frames whose backoff expired
+ *
+ * @code{.unparsed}
+ *  lock content store
+ *  for each pending entry
+ *   if due
+ *    remove from pending, copy frame, stamp last repair
+ *   else
+ *    remember earliest due
+ *   End If
+ *  End For
+ *  unlock content store
+ *  send copies at DACK rate
+ *  re-arm timer for earliest remaining due
+ * @endcode
+ */
+static enum hrtimer_restart cs_repair(struct hrtimer *t)
+{
+    struct cs_entry *e, *tmp;
+    struct sk_buff_head out;
+    struct sk_buff *skb;
+    ktime_t now = ktime_get(), next = 0;
+    __skb_queue_head_init(&out);
+    rcu_read_lock();
+    spin_lock_bh(&cs_lock);
+    list_for_each_entry_safe(e, tmp, &cs_pending, pend)
+    {
+        if (ktime_after(e->due, now))
+        {
+            if (!next || ktime_before(e->due, next))
+                next = e->due;
+            continue;
+        }
+        list_del(&e->pend);
+        e->pending = 0;
+        e->lastsent = jiffies;
+        skb = skb_copy(e->skb, GFP_ATOMIC);
+        if (skb)
+            __skb_queue_tail(&out, skb);
+    }
+    if (next && (!hrtimer_is_queued(&cs_timer) || ktime_before(next, hrtimer_get_expires(&cs_timer))))
+        hrtimer_start(&cs_timer, next, CS_TIMER_MODE);
+    spin_unlock_bh(&cs_lock);
+    rcu_read_unlock();
+    while ((skb = __skb_dequeue(&out)) != NULL)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_RETX_CS);
+        vmac_send_hack(skb);
+    }
+    return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief      Stop repair timer and free all cached frames
+ */
+void cs_stop(void)
+{
+    struct cs_entry *e, *tmp;
+    if (!cs_ready)
+        return;
+    spin_lock_bh(&cs_lock);
+    cs_ready = false;
+    list_for_each_entry_safe(e, tmp, &cs_lru, lru)
+        cs_drop(e);
+    spin_unlock_bh(&cs_lock);
+    hrtimer_cancel(&cs_timer);
+    rcu_barrier();
+    rhashtable_destroy(&cs_table);
+}
@@ -0,0 +1,33 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+
+/* Defines ********************************************************************/
+#define CS_HOLDOFF_US 1000  /* producer answers DACK at once, cache waits at least this long */
+#define CS_BACKOFF_US 2000  /* random backoff on top of hold-off, spreads caches answering same hole */
+#define CS_RESEND_MS 20     /* a cached frame is not repaired again within this time */
+#define CS_REPAIR_MAX 20    /* frames one DACK may schedule from the cache */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+#define CS_TIMER_MODE HRTIMER_MODE_ABS_SOFT
+#else
+#define CS_TIMER_MODE HRTIMER_MODE_ABS
+#endif
+
+struct sk_buff;
+
+/* content store functions */
+int cs_init(void);
+void cs_store(u64 enc, u16 seq, struct sk_buff *skb);
+void cs_heard(u64 enc, u16 seq);
+void cs_request(u64 enc, u16 le, u16 re, int *counter);
+void cs_stop(void);
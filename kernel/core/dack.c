@@ -13,10 +13,21 @@
 */
 #include "vmac.h"
 #include <linux/rhashtable.h>
+#include <linux/jhash.h>
 struct vmac_queue dqueue;
 struct vmac_queue dackfree;
 spinlock_t dackfreelok;
 u16 dackreqnum;
+static LIST_HEAD(dackpend); /* rx encodings with a DACK waiting for its timer */
+static DEFINE_SPINLOCK(dackpendlok);
+
+static uint dack_slot_us = 150;
+module_param(dack_slot_us, uint, 0644);
+MODULE_PARM_DESC(dack_slot_us, "V-MAC DACK slot length in microseconds (about one DACK airtime)");
+
+static int dack_slot_index = -1;
+module_param(dack_slot_index, int, 0644);
+MODULE_PARM_DESC(dack_slot_index, "V-MAC fixed DACK slot within a loss class (-1: hash of address and encoding)");
 
 
 /**
@@ -42,69 +53,434 @@ void request_DACK(u64 enc, u16 round)
     } */
 }
 
+/**
+ * @brief      Piggyback every other pending DACK onto the one about to be sent
+ *
+ * @param      self   encoding whose DACK timer fired
+ * @param      first  its DACK frame
+ *
+ * @return     frame to send: first itself if nothing else is pending,
+ * otherwise a VMAC_HDR_DACK_AGG frame carrying all collected sections
+ *
+ * @code{.unparsed}
+ * lock pending DACK list
+ * remove self from pending list
+ * for each pending encoding while under DACK_AGG_MAX sections and DACK_AGG_BYTES
+ *  try locking its DACK spinlock (skip if busy)
+ *  if it still has a DACK to send
+ *   take DACK frame, clear send signal and cancel its timer
+ *   remove it from pending list
+ *  else if nothing to send
+ *   remove it from pending list
+ * unlock pending DACK list
+ * if only first was collected
+ *  return first
+ * allocate aggregated frame (on failure send collected DACKs one by one)
+ * push V-MAC header with type VMAC_HDR_DACK_AGG and section count
+ * for each collected DACK
+ *  append encoding and compact DACK (i.e. frame minus V-MAC header)
+ *  free collected DACK
+ * @endcode
+ */
+static struct sk_buff* dack_aggregate(struct encoding_rx *self, struct sk_buff *first)
+{
+    struct sk_buff *parts[DACK_AGG_MAX];
+    struct encoding_rx *vmacr, *tmp;
+    struct sk_buff *skb;
+    struct vmac_hdr vmachdr;
+    struct vmac_DACK_agg agg;
+    struct vmac_DACK_section sec;
+    int n = 1, i, size, len;
+    parts[0] = first;
+    size = first->len - sizeof(struct vmac_hdr) + sizeof(struct vmac_DACK_section);
+    spin_lock(&dackpendlok);
+    list_del_init(&self->dack_list);
+    list_for_each_entry_safe(vmacr, tmp, &dackpend, dack_list)
+    {
+        if (n >= DACK_AGG_MAX)
+            break;
+        if (!spin_trylock(&vmacr->dacklok))
+            continue;
+        skb = vmacr->dac_info.dack;
+        if (vmacr->dac_info.send == 1 && skb)
+        {
+            len = skb->len - sizeof(struct vmac_hdr) + sizeof(struct vmac_DACK_section);
+            if (size + len <= DACK_AGG_BYTES)
+            {
+                vmacr->dac_info.send = 0;
+                vmacr->dac_info.dack = NULL;
+                hrtimer_try_to_cancel(&vmacr->dack_timer);
+                list_del_init(&vmacr->dack_list);
+                vmac_stat_inc(vmacr->stats, VMAC_STAT_DACK_TX);
+                parts[n++] = skb;
+                size += len;
+            }
+        }
+        else if (vmacr->dac_info.send == 0)
+        {
+            list_del_init(&vmacr->dack_list);
+        }
+        spin_unlock(&vmacr->dacklok);
+    }
+    spin_unlock(&dackpendlok);
+    if (n == 1)
+        return first;
+
+    skb = dev_alloc_skb(sizeof(struct ieee80211_hdr) + sizeof(struct vmac_hdr) + sizeof(struct vmac_DACK_agg) + size + BUFFER_ROOM);
+    if (!skb)
+    {
+        for (i = 1; i < n; i++)
+            vmac_send_hack(parts[i]);
+        return first;
+    }
+    skb_reserve(skb, sizeof(struct ieee80211_hdr));
+    vmachdr.enc = 0;
+    vmachdr.type = VMAC_HDR_DACK_AGG;
+    agg.count = n;
+    memcpy(skb_put(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
+    memcpy(skb_put(skb, sizeof(struct vmac_DACK_agg)), &agg, sizeof(struct vmac_DACK_agg));
+    for (i = 0; i < n; i++)
+    {
+        sec.enc = ((struct vmac_hdr*)parts[i]->data)->enc;
+        len = parts[i]->len - sizeof(struct vmac_hdr);
+        memcpy(skb_put(skb, sizeof(struct vmac_DACK_section)), &sec, sizeof(struct vmac_DACK_section));
+        memcpy(skb_put(skb, len), parts[i]->data + sizeof(struct vmac_hdr), len);
+        kfree_skb(parts[i]);
+    }
+    #ifdef DEBUG_MO
+        printk(KERN_INFO "VMACDACK: aggregated %d DACKs, %d bytes\n", n, skb->len);
+    #endif
+    return skb;
+}
+
 /**-------------------------------------------------------------------------*//**
  * V-MAC send DACK timer function
  *
- * @param      data  = pointer to struct dack_info
- * @return     N/A this is a timer function Pseudo Code
+ * @param      t  = pointer to dack_timer hrtimer within struct encoding_rx
+ * @return     HRTIMER_RESTART if DACK entry was busy, HRTIMER_NORESTART otherwise
+ * Pseudo Code
  * @code{.unparsed}
- * read dack_info structure from data pointer passed from pointer.
- * if structure does exists i.e. not NULL
- *  Allocate memory for queue entry and init free signal to 1 i.e. kmalloc
- *  if DACK spinlock exist within structure
- *   Try Locking DACK spinlock
- *    if send signal in structure is 1
- *     set send signal to 0
- *     if DACK frame exists within structure (sanity check)
- *      prepare entry queue with proper information (data rate=1 i.e. 2mbps by default)
- *      lock management queue
- *      insert DACK entry structure at end of linked list queue
- *      unlock management queue
- *    unlock DACK spinlock
- *   else
- *    set free signal to 0
- *    delete allocated memory for queue entry (hence is it not used) i.e. kfree
- *    Increment send DACK function timer by 2 jiffies (this indicates that DACK-
- *    -entry is being updated or reviewed due to another DACK reception or overlapping rounds)
- *    return
- *  if free signal is set
- *   delete allocated memory for queue entry (hence is it not used) i.e. kfree
+ * read dack_info structure from encoding owning the timer.
+ * Try Locking DACK spinlock
+ *  if entry is dead (see dack_forget)
+ *   unlock and return
+ *  if send signal in structure is 1
+ *   set send signal to 0
+ *   take DACK frame from structure
+ *   unlock DACK spinlock
+ *   aggregate other pending DACKs with it (see dack_aggregate)
+ *   send DACK frame at DACK rate
+ *  unlock DACK spinlock
+ * else
+ *  forward timer by DACK_RETRY_NS (this indicates that DACK-
+ *  -entry is being updated or reviewed due to another DACK reception or overlapping rounds)
+ *  return restart
  * @endcode 
- * @note: There is some redundancy, to be Fixed before release.
  */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
-void __sendDACK(struct timer_list *t)
+enum hrtimer_restart __sendDACK(struct hrtimer *t)
 {
-    struct encoding_rx* vmacr = from_timer(vmacr, t, dack_timer);
+    struct encoding_rx* vmacr = container_of(t, struct encoding_rx, dack_timer);
     struct dack_info* dac_info = &vmacr->dac_info;
-#else
-void __sendDACK(unsigned long data)
+    struct sk_buff* ptr;
+    if(!spin_trylock(dac_info->dacklok))
+    {
+        hrtimer_forward_now(t, ns_to_ktime(DACK_RETRY_NS));
+        return HRTIMER_RESTART;
+    }
+    if (!dac_info->dead && dac_info->send == 1)
+    {
+        dac_info->send = 0;
+        ptr = dac_info->dack;
+        dac_info->dack = NULL;
+        spin_unlock(dac_info->dacklok);            
+        #ifdef DEBUG_MO
+            printk(KERN_INFO "MO: SENDING DACK\n");            
+        #endif
+        if (ptr)
+        {
+            vmac_stat_inc(vmacr->stats, VMAC_STAT_DACK_TX);
+            vmac_send_hack(dack_aggregate(vmacr, ptr));
+        }
+    }
+    else 
+        spin_unlock(dac_info->dacklok);
+    return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief      Init DACK hrtimer of a new rx encoding
+ *
+ * @param      t     dack_timer within struct encoding_rx
+ */
+void dack_timer_init(struct hrtimer *t)
 {
-    struct dack_info* dac_info = (struct dack_info*) data;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+    hrtimer_setup(t, __sendDACK, CLOCK_MONOTONIC, DACK_TIMER_MODE);
+#else
+    hrtimer_init(t, CLOCK_MONOTONIC, DACK_TIMER_MODE);
+    t->function = __sendDACK;
 #endif
-    struct sk_buff* ptr;
-    if(dac_info)
+}
+
+/**
+ * @brief      Drop DACK state of an rx encoding about to be freed (removed from
+ * table, receive path may still hold it until the RCU grace period)
+ *
+ * @param      vmacr  The rx encoding
+ *
+ * @code{.unparsed}
+ *  lock DACK spinlock
+ *  mark entry dead so prepDACK and the timer leave it alone
+ *  take DACK frame, clear send signal
+ *  drop from pending DACK list
+ *  unlock DACK spinlock
+ *  cancel DACK timer, free DACK frame
+ * @endcode
+ */
+void dack_forget(struct encoding_rx *vmacr)
+{
+    struct sk_buff *ptr;
+    spin_lock_bh(&vmacr->dacklok);
+    vmacr->dac_info.dead = 1;
+    vmacr->dac_info.send = 0;
+    ptr = vmacr->dac_info.dack;
+    vmacr->dac_info.dack = NULL;
+    spin_lock(&dackpendlok);
+    list_del_init(&vmacr->dack_list);
+    spin_unlock(&dackpendlok);
+    spin_unlock_bh(&vmacr->dacklok);
+    hrtimer_cancel(&vmacr->dack_timer);
+    if (ptr)
+        kfree_skb(ptr);
+}
+
+/**
+ * @brief      Call fn for every lost run [le, re) of a compact DACK
+ *
+ * @param      ddr   compact DACK header
+ * @param      body  bitmap or RLE body (ddr->len bytes, already bounds checked)
+ * @param      fn    callback receiving each lost run
+ * @param      arg   passed to fn
+ *
+ * @code{.unparsed}
+ *  if format is bitmap
+ *   skip whole bytes with no loss, find each run of set bits (whole 0xff bytes at once)
+ *   call fn with run [base + start, base + end)
+ *  else if format is RLE
+ *   read alternating lost/received run lengths starting at base
+ *   call fn with every lost run
+ *  End If
+ * @endcode
+ */
+void dack_walk(const struct vmac_DACK_compact *ddr, const u8 *body, void (*fn)(u16 le, u16 re, void *arg), void *arg)
+{
+    u32 bit = 0, nbits = ddr->len * 8, start, run;
+    u16 le = ddr->base;
+    int pos = 0;
+    u8 inloss = 1;
+    if (ddr->fmt == VMAC_DACK_FMT_BITMAP)
+    {
+        while (bit < nbits)
+        {
+            if ((bit & 7) == 0 && body[bit >> 3] == 0)
+            {
+                bit += 8;
+                continue;
+            }
+            if (!(body[bit >> 3] & (1 << (bit & 7))))
+            {
+                bit++;
+                continue;
+            }
+            start = bit;
+            while (bit < nbits && (body[bit >> 3] & (1 << (bit & 7))))
+            {
+                bit += ((bit & 7) == 0 && body[bit >> 3] == 0xff) ? 8 : 1;
+            }
+            fn(ddr->base + start, ddr->base + bit, arg);
+        }
+    }
+    else if (ddr->fmt == VMAC_DACK_FMT_RLE)
+    {
+        while (pos < ddr->len)
+        {
+            pos = dack_rle_get(body, pos, ddr->len, &run);
+            if (pos < 0)
+                break;
+            if (inloss)
+            {
+                fn(le, le + run, arg);
+            }
+            le += run;
+            inloss = !inloss;
+        }
+    }
+}
+
+struct heard_ctx{
+    unsigned long *heard;
+    u16 start;
+    u16 end;
+};
+
+/**
+ * @brief      dack_walk callback: mark lost run of an overheard DACK within
+ * [start, end) of our own receive window
+ */
+static void heard_hole(u16 le, u16 re, void *arg)
+{
+    struct heard_ctx *ctx = (struct heard_ctx*) arg;
+    if (seq_before(le, ctx->start))
+        le = ctx->start;
+    if (seq_after(re, ctx->end))
+        re = ctx->end;
+    if (seq_after(re, le))
+        bitmap_set(ctx->heard, (u16)(le - ctx->start), (u16)(re - le));
+}
+
+/**
+ * @brief      Suppress our pending DACK if an overheard DACK already asks for
+ * every frame we lost (receivers with more loss speak first, see dack_slot)
+ *
+ * @param      vmacr  our rx encoding for the DACK encoding
+ * @param      ddr    overheard compact DACK header
+ * @param      body   overheard compact DACK body (already bounds checked)
+ *
+ * @code{.unparsed}
+ * try locking DACK spinlock (give up if busy)
+ * if we have no DACK waiting or overheard DACK is for an older round
+ *  unlock and return
+ * mark lost runs of overheard DACK within our DACK window
+ * for every frame we lost within our DACK window
+ *  if not marked
+ *   unlock and return //our DACK still carries new information
+ * clear send signal, take DACK frame and cancel DACK timer
+ * unlock DACK spinlock
+ * free DACK frame
+ * @endcode
+ */
+void dack_overheard(struct encoding_rx *vmacr, const struct vmac_DACK_compact *ddr, const u8 *body)
+{
+    DECLARE_BITMAP(heard, WINDOW);
+    struct heard_ctx ctx;
+    struct sk_buff *ptr;
+    u16 i;
+    if (!spin_trylock(&vmacr->dacklok))
+        return;
+    if (vmacr->dac_info.send != 1 || seq_before(round_seq(ddr->round), round_seq(vmacr->dac_info.round)))
+    {
+        spin_unlock(&vmacr->dacklok);
+        return;
+    }
+    ctx.end = round_seq(vmacr->dac_info.round);
+    ctx.start = ctx.end - WINDOW;
+    ctx.heard = heard;
+    bitmap_zero(heard, WINDOW);
+    dack_walk(ddr, body, heard_hole, &ctx);
+    for (i = ctx.start; i != ctx.end; i++)
     {
-        if(!spin_trylock(dac_info->dacklok))
+        if (!test_bit(i % WINDOW, vmacr->window) && !test_bit((u16)(i - ctx.start), heard))
         {
-            mod_timer(dac_info->dack_timer, jiffies + msecs_to_jiffies(100));
+            spin_unlock(&vmacr->dacklok);
             return;
         }
-        if (dac_info->send == 1)
+    }
+    vmacr->dac_info.send = 0;
+    ptr = vmacr->dac_info.dack;
+    vmacr->dac_info.dack = NULL;
+    hrtimer_try_to_cancel(&vmacr->dack_timer);
+    spin_unlock(&vmacr->dacklok);
+    vmac_stat_inc(vmacr->stats, VMAC_STAT_DACK_SUPPRESSED);
+    #ifdef DEBUG_MO
+        printk(KERN_INFO "VMACDACK: suppressed DACK round %u for %llu\n", ddr->round, vmacr->key);
+    #endif
+    if (ptr)
+        kfree_skb(ptr);
+}
+
+/**
+ * @brief      DACK slot of this receiver for an encoding round
+ *
+ * @param[in]  enc    encoding value
+ * @param[in]  round  DACK round
+ * @param[in]  lost   frames lost within DACK window
+ *
+ * @return     slot index, lower slots transmit first
+ *
+ * @code{.unparsed}
+ * loss class = log2 bucket of lost frames (capped at DACK_LOSS_CLASSES - 1)
+ * if fixed slot index configured
+ *  sub slot = configured index
+ * else
+ *  sub slot = hash of our address, encoding and round
+ * return (most loss first) class group * DACK_SLOTS_PER_CLASS + sub slot
+ * @endcode
+ */
+static u32 dack_slot(u64 enc, u16 round, u16 lost)
+{
+    u32 class = min_t(u32, fls(lost), DACK_LOSS_CLASSES - 1);
+    u32 sub;
+    if (dack_slot_index >= 0)
+        sub = dack_slot_index % DACK_SLOTS_PER_CLASS;
+    else
+        sub = jhash(vmac_get_addr(), ETH_ALEN, (u32)enc ^ (u32)(enc >> 32) ^ round) % DACK_SLOTS_PER_CLASS;
+    return (DACK_LOSS_CLASSES - 1 - class) * DACK_SLOTS_PER_CLASS + sub;
+}
+
+/**
+ * @brief      Append one run length to a compact DACK RLE body as a 7-bit varint
+ *
+ * @param      buf   RLE buffer
+ * @param[in]  pos   current write offset
+ * @param[in]  max   size of buffer
+ * @param[in]  run   run length to encode
+ *
+ * @return     new write offset, or -1 if the run does not fit
+ */
+int dack_rle_put(u8 *buf, int pos, int max, u32 run)
+{
+    do
+    {
+        if (pos >= max)
         {
-            dac_info->send = 0;
-            ptr = dac_info->dack;
-            dac_info->dack = NULL;
-            spin_unlock(dac_info->dacklok);            
-            printk(KERN_INFO "MO: SENDING DACK\n");            
-            //add_DACK(ptr);
-            vmac_send_hack(ptr);
+            return -1;
         }
-        else 
-            spin_unlock(dac_info->dacklok);
+        buf[pos] = run & 0x7f;
+        run >>= 7;
+        if (run)
+        {
+            buf[pos] |= 0x80;
         }
+        pos++;
+    } while (run);
+    return pos;
 }
 
+/**
+ * @brief      Read one run length from a compact DACK RLE body
+ *
+ * @param      buf   RLE buffer
+ * @param[in]  pos   current read offset
+ * @param[in]  max   size of buffer
+ * @param      run   decoded run length
+ *
+ * @return     new read offset, or -1 if the body is truncated or malformed
+ */
+int dack_rle_get(const u8 *buf, int pos, int max, u32 *run)
+{
+    int shift = 0;
+    *run = 0;
+    do
+    {
+        if (pos >= max || shift > 21)
+        {
+            return -1;
+        }
+        *run |= (u32)(buf[pos] & 0x7f) << shift;
+        shift += 7;
+    } while (buf[pos++] & 0x80);
+    return pos;
+}
 
 /**
  * @brief      Prepare DACK frame
@@ -115,128 +491,165 @@ void __sendDACK(unsigned long data)
  * @code{.unparsed}
  * init variables
  * set DACK header encoding header to encoding parameter passed to function
- * set type of frame to VMAC_HDR_DACK
- * ------------------Calculating holes values i.e. right edge and left edges----------------
- * for i either 0 (i.e. sequence number 0) or latest sequence received - RX_WINDOW
+ * set type of frame to VMAC_HDR_DACK_COMPACT
+ * ------------------Calculating loss state over the receive window---------------------------
+ * for i from round sequence - WINDOW up to round sequence (wraps, see round_seq),
+ * starting no earlier than latest - WINDOW + 1 (older slots already hold newer sequences)
  *  if ith frame is not received
- *   tmp=i
- *   while (tmp-1)th frame is lost, tmp >= 0, latest frame received -RX_WINDOW <tmp-1 (i.e. prevent wrap around)
- *    decrement tmp
- *    increment loss
- *   set left edge to tmp
- *   set holes struct left edge value to tmp
- *   while ith element is lost and i is less than latest frame received - 1
- *    increment i
- *    increment loss
- *   set right edge to i
- *   set holes struct right edge vlaue to i
- *   increment holes_num variable by 1
- *  allocate memory for headers and holes for this DACK
- *  push headers into memory allocated within buffer
+ *   record first and last lost sequence
+ *   increment loss
+ * if any frame is lost
+ *  build loss bitmap from first lost to last lost (one bit per sequence)
+ *  build run length encoding of alternating lost/received runs starting at first lost
+ *  pick whichever is smaller (RLE gives up as soon as it exceeds the bitmap)
+ * allocate memory for headers and compact body for this DACK
+ * push headers into memory allocated within buffer
+ * unless encoding is being freed (dead, see dack_forget)
  *  add it to queue or swap old DACK with new DACK
+ *  add encoding to pending DACK list so other timers can aggregate it
  * -----------------------------------------------------------------------------------------
  * @encode
  */
 void prepDACK(u64 enc, u16 round)
 {
     struct encoding_rx *vmac;
-    struct vmac_DACK ddr;
+    struct vmac_DACK_compact ddr;
     struct vmac_hdr vmachdr;
     struct dack_info *dac_info;
     struct sk_buff *skb, *ptr = NULL;
-    struct vmac_hole holesy[HOLES_MAX]; /* needs improvement */ 
-    long duration, rndm = 0;
-    int tmp, skbsize;    
-    u8 loss = 0;
-    u16 holes = 0, i = 0, le, re, lattmp;
+    u8 bitmap[DACK_BITMAP_MAX];
+    u8 rle[DACK_BITMAP_MAX];
+    u8 *body = NULL;
+    u64 duration;
+    int skbsize, bitlen = 0, rlelen = 0;
+    u32 run;
+    u16 lost = 0, i, first = 0, last = 0, start, lattmp, oldest;
+    u8 inloss;
     vmac = find_rx(RX_TABLE,enc); 
     dac_info = &vmac->dac_info;
     vmachdr.enc = enc;
-    vmachdr.type = VMAC_HDR_DACK;
-    get_random_bytes(&rndm, sizeof(rndm));
-    rndm = rndm % 2;
-    lattmp = round * 5;
+    vmachdr.type = VMAC_HDR_DACK_COMPACT;
+    lattmp = round_seq(round);
+    start = lattmp - WINDOW; /* sequences before stream start are marked received, see vmac_rx */
+    /* window moved on since the round: its first slots were reused by newer sequences */
+    oldest = READ_ONCE(vmac->latest) - WINDOW + 1;
+    if (seq_after(oldest, start))
+        start = seq_before(oldest, lattmp) ? oldest : lattmp;
     #ifdef DEBUG_MO
         printk(KERN_INFO "Encoding of DACK = %lld", enc);
     #endif
-    /*-Calculating holes values i.e. right edge and left edges*/
-    for(i = (lattmp < WINDOW ? 0 : lattmp - WINDOW) ; ( i < lattmp && holes < HOLES_MAX) ; i++)
+    /* Calculating loss range over the receive window */
+    for(i = start; i != lattmp; i++)
     {
-        if (vmac->window[i % WINDOW] == 0)
+        if (!test_bit(i % WINDOW, vmac->window))
         {
-            tmp = i;
-            while(vmac->window[tmp % WINDOW - 1] == 0 && tmp > 0 && (lattmp < WINDOW ? 0: lattmp - WINDOW) < tmp - 1)
+            if (lost == 0)
             {
-                tmp--;
-                loss++;
+                first = i;
             }
-            le = tmp;
-            holesy[holes].le = tmp;
-            while(vmac->window[i % WINDOW] == 0 && i < lattmp - 1)
+            last = i;
+            lost++;
+        }
+    }
+
+    if (lost)
+    {
+        /* bitmap: one bit per sequence from first to last lost */
+        bitlen = ((u16)(last - first) + 8) / 8;
+        memset(bitmap, 0, bitlen);
+        /* RLE: alternating lost/received runs starting with a lost run */
+        run = 0;
+        inloss = 1;
+        for(i = first; rlelen >= 0; i++)
+        {
+            if ((!test_bit(i % WINDOW, vmac->window)) != inloss)
             {
-                i++;
-                loss++;
+                rlelen = dack_rle_put(rle, rlelen, bitlen, run);
+                inloss = !inloss;
+                run = 0;
             }
-            re = i;
-            holesy[holes].re = re;
-            holes++;
+            if (inloss)
+            {
+                bitmap[(u16)(i - first) / 8] |= 1 << ((u16)(i - first) % 8);
+            }
+            run++;
+            if (i == last)
+            {
+                if (rlelen >= 0)
+                {
+                    rlelen = dack_rle_put(rle, rlelen, bitlen, run);
+                }
+                break;
+            }
+        }
+        /* finish the bitmap if RLE gave up early */
+        for(; !seq_after(i, last); i++)
+        {
+            if (!test_bit(i % WINDOW, vmac->window))
+            {
+                bitmap[(u16)(i - first) / 8] |= 1 << ((u16)(i - first) % 8);
+            }
+        }
+
+        if (rlelen >= 0 && rlelen < bitlen)
+        {
+            ddr.fmt = VMAC_DACK_FMT_RLE;
+            ddr.len = rlelen;
+            body = rle;
+        }
+        else
+        {
+            ddr.fmt = VMAC_DACK_FMT_BITMAP;
+            ddr.len = bitlen;
+            body = bitmap;
         }
-       
+        ddr.base = first;
     }
+    else
+    {
+        ddr.fmt = VMAC_DACK_FMT_BITMAP;
+        ddr.len = 0;
+        ddr.base = lattmp;
+    }
+    ddr.round = round;
 
     /* allocate skb struct and start placing headers */
-    skbsize = sizeof(struct ieee80211_hdr) + sizeof(struct vmac_hdr) + sizeof(struct vmac_DACK) + holes * sizeof(struct vmac_hole) + BUFFER_ROOM;    
+    skbsize = sizeof(struct ieee80211_hdr) + sizeof(struct vmac_hdr) + sizeof(struct vmac_DACK_compact) + ddr.len + BUFFER_ROOM;    
     skb = dev_alloc_skb(skbsize);
     if (!skb)
     {
+        vmac_stat_inc(vmac->stats, VMAC_STAT_ALLOC_FAIL);
         return;
     }
+    skb_reserve(skb, sizeof(struct ieee80211_hdr) + sizeof(struct vmac_hdr));
     #ifdef DEBUG_MO
-        printk(KERN_INFO"VMACDACK: Holes= %u, sizeof skb= %d\n",holes, skbsize);
+        printk(KERN_INFO"VMACDACK: lost= %u, fmt= %u, len= %u, sizeof skb= %d\n", lost, ddr.fmt, ddr.len, skbsize);
     #endif
-    ddr.holes = holes;
-    ddr.round = round;
-    
-    memcpy(skb_put(skb, sizeof(struct vmac_DACK)), &ddr, sizeof(struct vmac_DACK));
-    for( i = 0; i < holes; i++)
+    memcpy(skb_put(skb, sizeof(struct vmac_DACK_compact)), &ddr, sizeof(struct vmac_DACK_compact));
+    if (ddr.len)
     {
-        #ifdef DEBUG_MO
-            printk(KERN_INFO"VMACDACK: LE= %d, RE= %d\n",holesy[i].le, holesy[i].re);
-        #endif
-        memcpy(skb_put(skb, sizeof(struct vmac_hole)), &holesy[i], sizeof(struct vmac_hole));
+        memcpy(skb_put(skb, ddr.len), body, ddr.len);
     }
     memcpy(skb_push(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
     
-
-    if (loss <= 5)
-    {
-    	/* this should always occur*/
-    	loss = 5 - loss;
-    } 
-
-    if (vmac->alpha>=100){
-    /* Safety in case clock loops back */
-    vmac->alpha=100;
-	}
-
-    duration = 2 * vmac->alpha * (loss + rndm); //should be 5-loss but who keeps counting (ehh got many other bugs to fix first.lmao it's a festival of bugs wohooooo BUGSSSSSSSSSS
-    if (duration == 0){
-    	duration = 1;
-    }
+    duration = 2 * vmac->alpha + (u64)dack_slot(enc, round, lost) * dack_slot_us * NSEC_PER_USEC;
+    duration = clamp_t(u64, duration, DACK_DELAY_MIN_NS, DACK_DELAY_MAX_NS);
    
     while(!spin_trylock (&vmac->dacklok))
     {
         kfree_skb(skb);
         return;
     }
+    if (dac_info->dead)
+    {
+        spin_unlock(&vmac->dacklok);
+        kfree_skb(skb);
+        return;
+    }
 
     if (dac_info->send == 1)
     {
-        if (vmac->dac_info.dack)//mo-new:  vmac->dac_info.dack != NULL
-        {
-            rndm = 1;
-            ptr = vmac->dac_info.dack;
-        }
+        ptr = vmac->dac_info.dack;
 
         dac_info->send = 1;
         dac_info->dacksheard = 0;
@@ -251,16 +664,17 @@ void prepDACK(u64 enc, u16 round)
         dac_info->dacksheard = 0;
         dac_info->round = ddr.round;
         vmac->DACK = skb;
-        
-        if (duration > 100)
-         {
-            duration = 10;//reset to prevent kernel crash
-    	}
-
-       	mod_timer(&vmac->dack_timer, jiffies + duration);
+        hrtimer_start(&vmac->dack_timer, ns_to_ktime(duration), DACK_TIMER_MODE);
+    }
+    /* still under DACK spinlock, so dack_forget cannot unlink in between */
+    spin_lock(&dackpendlok);
+    if (list_empty(&vmac->dack_list))
+    {
+        list_add_tail(&vmac->dack_list, &dackpend);
     }
+    spin_unlock(&dackpendlok);
     spin_unlock(&vmac->dacklok);
-    if (rndm == 1)
+    if (ptr)
     {
         kfree_skb(ptr);
     }
@@ -17,6 +17,23 @@
 #define RX_WINDOW 450
 #define HOLES_MAX 40
 #define BUFFER_ROOM 120
+#define DACK_BITMAP_MAX ((WINDOW + 7) / 8)
+#define DACK_RETX_MAX 20
+#define DACK_AGG_MAX 16 /* max encodings per aggregated DACK */
+#define DACK_AGG_BYTES 1024 /* max sections size of aggregated DACK */
+#define ALPHA_SHIFT 3 /* EWMA gain of 1/8 for inter-frame gap */
+#define DACK_DELAY_MIN_NS (10 * NSEC_PER_USEC)
+/* DACK delay clamp: 10 ms for 2 * alpha, plus room for the DACK_LOSS_CLASSES *
+ * DACK_SLOTS_PER_CLASS slots of dack_slot_us (9.6 ms at the default 150 us) */
+#define DACK_DELAY_MAX_NS (20 * NSEC_PER_MSEC)
+#define DACK_LOSS_CLASSES 8 /* log2 loss buckets, most loss gets earliest slots */
+#define DACK_SLOTS_PER_CLASS 8
+#define DACK_RETRY_NS (100 * NSEC_PER_USEC)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+#define DACK_TIMER_MODE HRTIMER_MODE_REL_SOFT
+#else
+#define DACK_TIMER_MODE HRTIMER_MODE_REL
+#endif
 
 
 /* DACK functions */
@@ -26,12 +43,16 @@
  */
 void dack_start(void);
 int dackgen(void *data);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
-void __sendDACK(struct timer_list *t);
-#else
-void __sendDACK(unsigned long data);
-#endif
+enum hrtimer_restart __sendDACK(struct hrtimer *t);
+void dack_timer_init(struct hrtimer *t);
+struct encoding_rx;
+struct vmac_DACK_compact;
+void dack_forget(struct encoding_rx *vmacr);
+void dack_walk(const struct vmac_DACK_compact *ddr, const u8 *body, void (*fn)(u16 le, u16 re, void *arg), void *arg);
+void dack_overheard(struct encoding_rx *vmacr, const struct vmac_DACK_compact *ddr, const u8 *body);
 int dackdel(void *data);
 void prepDACK(u64 enc,u16 round);
 void dack_init(void);
 void request_DACK(u64 enc, u16 round);
+int dack_rle_put(u8 *buf, int pos, int max, u32 run);
+int dack_rle_get(const u8 *buf, int pos, int max, u32 *run);
@@ -0,0 +1,310 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include "vmac.h"
+
+static struct genl_family vmac_genl_family;
+static bool genl_registered;
+
+static const struct nla_policy vmac_genl_policy[VMAC_A_MAX + 1] = {
+    [VMAC_A_ENC] = { .type = NLA_U64 },
+    [VMAC_A_TYPE] = { .type = NLA_U8 },
+    [VMAC_A_SEQ] = { .type = NLA_U16 },
+    [VMAC_A_RATE] = { .type = NLA_U8 },
+    [VMAC_A_BW] = { .type = NLA_U8 },
+    [VMAC_A_SGI] = { .type = NLA_U8 },
+    [VMAC_A_STREAM] = { .type = NLA_U8 },
+    [VMAC_A_DATA] = { .type = NLA_BINARY },
+    [VMAC_A_CONFIG_KEY] = { .type = NLA_U8 },
+    [VMAC_A_CONFIG_VAL] = { .type = NLA_U32 },
+    [VMAC_A_MTU] = { .type = NLA_U16 },
+    [VMAC_A_OBJ_ID] = { .type = NLA_U32 },
+    [VMAC_A_OBJ_LEN] = { .type = NLA_U32 },
+    [VMAC_A_OBJ_IDX] = { .type = NLA_U16 },
+};
+
+static u8 attr_u8(struct genl_info *info, int attr, u8 def)
+{
+    return info->attrs[attr] ? nla_get_u8(info->attrs[attr]) : def;
+}
+
+static int genl_register(struct sk_buff *skb, struct genl_info *info)
+{
+    vmac_app_register(info->snd_portid, 1);
+    return 0;
+}
+
+/**
+ * @brief      VMAC_CMD_TX: send interest, data, announcement or injected frame
+ */
+static int genl_tx(struct sk_buff *skb, struct genl_info *info)
+{
+    struct nlattr *data = info->attrs[VMAC_A_DATA];
+    u8 type;
+    if (!info->attrs[VMAC_A_ENC] || !info->attrs[VMAC_A_TYPE])
+        return -EINVAL;
+    type = nla_get_u8(info->attrs[VMAC_A_TYPE]);
+    if (type != VMAC_HDR_INTEREST && type != VMAC_HDR_DATA && type != VMAC_HDR_ANOUNCMENT && type != VMAC_HDR_INJECTED)
+        return -EINVAL;
+    if (data && nla_len(data) > VMAC_MTU_MAX + sizeof(struct vmac_seg))
+        return -EMSGSIZE;
+    vmac_user_tx(nla_get_u64(info->attrs[VMAC_A_ENC]), type,
+        info->attrs[VMAC_A_SEQ] ? nla_get_u16(info->attrs[VMAC_A_SEQ]) : 0,
+        data ? nla_data(data) : NULL, data ? nla_len(data) : 0,
+        attr_u8(info, VMAC_A_RATE, 0), attr_u8(info, VMAC_A_BW, 0), attr_u8(info, VMAC_A_SGI, 0), attr_u8(info, VMAC_A_STREAM, 0),
+        info->snd_portid, 1);
+    return 0;
+}
+
+/**
+ * @brief      VMAC_CMD_BULK: bulk publication, object if VMAC_A_OBJ_ID given
+ */
+static int genl_bulk(struct sk_buff *skb, struct genl_info *info)
+{
+    struct nlattr *data = info->attrs[VMAC_A_DATA];
+    struct vmac_seg seg;
+    bool obj = info->attrs[VMAC_A_OBJ_ID] != NULL;
+    if (!info->attrs[VMAC_A_ENC] || !data || (obj && !info->attrs[VMAC_A_OBJ_LEN]))
+        return -EINVAL;
+    if (obj)
+    {
+        seg.id = nla_get_u32(info->attrs[VMAC_A_OBJ_ID]);
+        seg.len = nla_get_u32(info->attrs[VMAC_A_OBJ_LEN]);
+        seg.mtu = 0;
+        seg.idx = info->attrs[VMAC_A_OBJ_IDX] ? nla_get_u16(info->attrs[VMAC_A_OBJ_IDX]) : 0;
+    }
+    vmac_user_bulk(nla_get_u64(info->attrs[VMAC_A_ENC]), nla_data(data), nla_len(data),
+        info->attrs[VMAC_A_MTU] ? nla_get_u16(info->attrs[VMAC_A_MTU]) : 0, obj ? &seg : NULL,
+        attr_u8(info, VMAC_A_RATE, 0), attr_u8(info, VMAC_A_BW, 0), attr_u8(info, VMAC_A_SGI, 0), attr_u8(info, VMAC_A_STREAM, 0),
+        info->snd_portid, 1);
+    return 0;
+}
+
+static int genl_config(struct sk_buff *skb, struct genl_info *info)
+{
+    if (!info->attrs[VMAC_A_CONFIG_KEY] || !info->attrs[VMAC_A_CONFIG_VAL])
+        return -EINVAL;
+    vmac_user_config(info->attrs[VMAC_A_ENC] ? nla_get_u64(info->attrs[VMAC_A_ENC]) : 0,
+        nla_get_u8(info->attrs[VMAC_A_CONFIG_KEY]), nla_get_u32(info->attrs[VMAC_A_CONFIG_VAL]),
+        info->snd_portid, 1);
+    return 0;
+}
+
+/**
+ * @brief      VMAC_CMD_STATS: reply with global counters
+ */
+static int genl_stats(struct sk_buff *skb, struct genl_info *info)
+{
+    struct sk_buff *msg;
+    struct nlattr *nest;
+    void *hdr;
+    u64 val;
+    int i;
+    msg = genlmsg_new(nla_total_size(VMAC_STAT_MAX * nla_total_size(sizeof(u64))), GFP_KERNEL);
+    if (!msg)
+        return -ENOMEM;
+    hdr = genlmsg_put_reply(msg, info, &vmac_genl_family, 0, VMAC_CMD_STATS);
+    if (!hdr)
+        goto fail;
+    nest = nla_nest_start(msg, VMAC_A_STATS);
+    if (!nest)
+        goto fail;
+    for (i = 0; i < VMAC_STAT_MAX; i++)
+    {
+        val = vmac_stat_sum(NULL, i);
+        if (nla_put(msg, i + 1, sizeof(u64), &val))
+            goto fail;
+    }
+    nla_nest_end(msg, nest);
+    genlmsg_end(msg, hdr);
+    return genlmsg_reply(msg, info);
+fail:
+    nlmsg_free(msg);
+    return -EMSGSIZE;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)
+#define VMAC_GENL_OP(c, fn) { .cmd = c, .doit = fn, .validate = GENL_DONT_VALIDATE_STRICT | GENL_DONT_VALIDATE_DUMP }
+#else
+#define VMAC_GENL_OP(c, fn) { .cmd = c, .doit = fn, .policy = vmac_genl_policy }
+#endif
+
+/* unknown attributes are ignored (no strict validation) so newer libraries work with older modules */
+static const struct genl_ops vmac_genl_ops[] = {
+    VMAC_GENL_OP(VMAC_CMD_REGISTER, genl_register),
+    VMAC_GENL_OP(VMAC_CMD_TX, genl_tx),
+    VMAC_GENL_OP(VMAC_CMD_BULK, genl_bulk),
+    VMAC_GENL_OP(VMAC_CMD_CONFIG, genl_config),
+    VMAC_GENL_OP(VMAC_CMD_STATS, genl_stats),
+};
+
+static const struct genl_multicast_group vmac_genl_mcgrps[] = {
+    { .name = VMAC_GENL_MCGRP_EVENTS },
+};
+
+static struct genl_family vmac_genl_family = {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0)
+    .id = GENL_ID_GENERATE,
+#else
+    .module = THIS_MODULE,
+    .ops = vmac_genl_ops,
+    .n_ops = ARRAY_SIZE(vmac_genl_ops),
+    .mcgrps = vmac_genl_mcgrps,
+    .n_mcgrps = ARRAY_SIZE(vmac_genl_mcgrps),
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)
+    .policy = vmac_genl_policy,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,1,0)
+    .resv_start_op = __VMAC_CMD_MAX,
+#endif
+    .name = VMAC_GENL_NAME,
+    .version = VMAC_GENL_VERSION,
+    .maxattr = VMAC_A_MAX,
+    .parallel_ops = true, /* handlers lock what they share, producers on several cores are not serialized */
+};
+
+int vmac_genl_init(void)
+{
+    int ret;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0)
+    ret = genl_register_family_with_ops_groups(&vmac_genl_family, vmac_genl_ops, vmac_genl_mcgrps);
+#else
+    ret = genl_register_family(&vmac_genl_family);
+#endif
+    genl_registered = !ret;
+    return ret;
+}
+
+void vmac_genl_exit(void)
+{
+    if (genl_registered)
+        genl_unregister_family(&vmac_genl_family);
+    genl_registered = false;
+}
+
+/**
+ * @brief      generic netlink counterpart of vmac_nl_new: VMAC_CMD_RX with ENC,
+ * TYPE and len bytes of DATA
+ *
+ * @param[in]  port  netlink port message goes to
+ */
+struct sk_buff* vmac_genl_new(u8 type, u64 enc, u32 len, gfp_t gfp, u32 port, u8 **data)
+{
+    struct sk_buff *msg;
+    struct nlattr *a;
+    void *hdr;
+    if (len > U16_MAX - NLA_HDRLEN)
+        return NULL;
+    msg = genlmsg_new(nla_total_size_64bit(sizeof(u64)) + nla_total_size(sizeof(u8)) + nla_total_size(len), gfp);
+    if (!msg)
+        return NULL;
+    hdr = genlmsg_put(msg, port, 0, &vmac_genl_family, 0, VMAC_CMD_RX);
+    if (!hdr || nla_put_u64_64bit(msg, VMAC_A_ENC, enc, VMAC_A_PAD) || nla_put_u8(msg, VMAC_A_TYPE, type))
+        goto fail;
+    a = nla_reserve(msg, VMAC_A_DATA, len);
+    if (!a)
+        goto fail;
+    *data = nla_data(a);
+    genlmsg_end(msg, hdr);
+    return msg;
+fail:
+    nlmsg_free(msg);
+    return NULL;
+}
+
+/**
+ * @brief      whether message was built by vmac_genl_new
+ */
+bool vmac_genl_msg(const struct sk_buff *skb)
+{
+    return genl_registered && nlmsg_hdr(skb)->nlmsg_type == vmac_genl_family.id;
+}
+
+/**
+ * @brief      send message of vmac_genl_new to its port (consumes it)
+ */
+void vmac_genl_send(struct sk_buff *skb)
+{
+    genlmsg_unicast(&init_net, skb, nlmsg_hdr(skb)->nlmsg_pid);
+}
+
+/**
+ * @brief      Pass received frame to generic netlink process (consumes frame)
+ *
+ * @param      skb   The frame, data pointing at payload followed by FCS
+ * @param[in]  port  netlink port of process
+ *
+ * @code{.unparsed}
+ *  allocate message for attributes and payload less FCS
+ *  put encoding, type, sequence, PHY rate, bandwidth, guard interval, signal and
+ *  reception time, then payload
+ *  unicast to process
+ *  free frame
+ * @endcode
+ */
+void vmac_genl_rx(struct sk_buff *skb, u64 enc, u8 type, u16 seq, u32 port)
+{
+    struct ieee80211_rx_status *status = IEEE80211_SKB_RXCB(skb);
+    struct sk_buff *msg;
+    void *hdr;
+    u32 len = skb->len > 4 ? skb->len - 4 : 0;
+    u8 bw = status->bw == RATE_INFO_BW_80 ? 2 : (status->bw == RATE_INFO_BW_40 ? 1 : 0);
+    msg = genlmsg_new(2 * nla_total_size_64bit(sizeof(u64)) + 5 * nla_total_size(sizeof(u8))
+        + nla_total_size(sizeof(u16)) + nla_total_size(len), GFP_ATOMIC);
+    if (!msg)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+        kfree_skb(skb);
+        return;
+    }
+    hdr = genlmsg_put(msg, port, 0, &vmac_genl_family, 0, VMAC_CMD_RX);
+    if (!hdr || nla_put_u64_64bit(msg, VMAC_A_ENC, enc, VMAC_A_PAD) || nla_put_u8(msg, VMAC_A_TYPE, type)
+        || nla_put_u16(msg, VMAC_A_SEQ, seq) || nla_put_u8(msg, VMAC_A_RATE, status->rate_idx)
+        || nla_put_u8(msg, VMAC_A_BW, bw) || nla_put_u8(msg, VMAC_A_SGI, !!(status->enc_flags & RX_ENC_FLAG_SHORT_GI))
+        || nla_put_s8(msg, VMAC_A_SIGNAL, status->signal)
+        || nla_put_u64_64bit(msg, VMAC_A_TSTAMP, ktime_get_real_ns(), VMAC_A_PAD)
+        || nla_put(msg, VMAC_A_DATA, len, skb->data))
+    {
+        nlmsg_free(msg);
+        kfree_skb(skb);
+        return;
+    }
+    genlmsg_end(msg, hdr);
+    genlmsg_unicast(&init_net, msg, port);
+    kfree_skb(skb);
+}
+
+/**
+ * @brief      Multicast event to generic netlink event group (monitoring tools),
+ * if anyone listens. The owner of the encoding gets it unicast (vmac_nl_event).
+ */
+void vmac_genl_event(u8 type, u64 enc, const void *data, u16 len)
+{
+    struct sk_buff *msg;
+    void *hdr;
+    if (!genl_registered || !genl_has_listeners(&vmac_genl_family, &init_net, 0))
+        return;
+    msg = genlmsg_new(nla_total_size_64bit(sizeof(u64)) + nla_total_size(sizeof(u8)) + nla_total_size(len), GFP_ATOMIC);
+    if (!msg)
+        return;
+    hdr = genlmsg_put(msg, 0, 0, &vmac_genl_family, 0, VMAC_CMD_EVENT);
+    if (!hdr || nla_put_u64_64bit(msg, VMAC_A_ENC, enc, VMAC_A_PAD) || nla_put_u8(msg, VMAC_A_TYPE, type)
+        || nla_put(msg, VMAC_A_DATA, len, data))
+    {
+        nlmsg_free(msg);
+        return;
+    }
+    genlmsg_end(msg, hdr);
+    genlmsg_multicast(&vmac_genl_family, msg, 0, 0, GFP_ATOMIC);
+}
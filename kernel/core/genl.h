@@ -0,0 +1,68 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include <net/genetlink.h>
+
+/*
+ * Generic netlink family "vmac": control plane with typed attributes, next to
+ * raw netlink VMAC_USER. Attributes are only ever added, and unknown ones are
+ * ignored, so kernel module and library need not be upgraded together.
+ */
+#define VMAC_GENL_NAME "vmac"
+#define VMAC_GENL_VERSION 1
+#define VMAC_GENL_MCGRP_EVENTS "events" /* VMAC_CMD_EVENT messages (e.g. pressure) for monitoring tools */
+
+enum vmac_genl_cmd {
+    VMAC_CMD_UNSPEC,
+    VMAC_CMD_REGISTER, /* process registers, no attributes */
+    VMAC_CMD_TX, /* ENC, TYPE, [SEQ, RATE, BW, SGI, STREAM, DATA] */
+    VMAC_CMD_BULK, /* ENC, DATA, [RATE, BW, SGI, STREAM, MTU], object: OBJ_ID, OBJ_LEN, [OBJ_IDX] */
+    VMAC_CMD_CONFIG, /* CONFIG_KEY, CONFIG_VAL, [ENC] */
+    VMAC_CMD_STATS, /* request without attributes, reply: STATS */
+    VMAC_CMD_RX, /* kernel to process: ENC, TYPE, [SEQ, RATE, BW, SGI, SIGNAL, TSTAMP], DATA */
+    VMAC_CMD_EVENT, /* kernel to event group: ENC, TYPE, DATA */
+    __VMAC_CMD_MAX,
+};
+
+enum vmac_genl_attr {
+    VMAC_A_UNSPEC,
+    VMAC_A_PAD,
+    VMAC_A_ENC, /* u64 encoding */
+    VMAC_A_TYPE, /* u8 frame type (VMAC_HDR_*) or message type (VMAC_PRESSURE, VMAC_OBJECT, VMAC_GAP, VMAC_TXDONE) */
+    VMAC_A_SEQ, /* u16 sequence */
+    VMAC_A_RATE, /* u8 rate index, VMAC_RATE_AUTO on tx */
+    VMAC_A_BW, /* u8 0 = 20 MHz, 1 = 40 MHz, 2 = 80 MHz */
+    VMAC_A_SGI, /* u8 short guard interval */
+    VMAC_A_STREAM, /* u8 spatial streams less one */
+    VMAC_A_DATA, /* frame payload, or struct of message type (struct vmac_pressure, struct vmac_object and object, struct vmac_gap, struct vmac_txdone) */
+    VMAC_A_CONFIG_KEY, /* u8 VMAC_CONFIG_* */
+    VMAC_A_CONFIG_VAL, /* u32 */
+    VMAC_A_MTU, /* u16 payload per data frame of bulk publication */
+    VMAC_A_OBJ_ID, /* u32 object id */
+    VMAC_A_OBJ_LEN, /* u32 length of whole object */
+    VMAC_A_OBJ_IDX, /* u16 segment index of first byte of DATA */
+    VMAC_A_SIGNAL, /* s8 signal (dBm) of received frame */
+    VMAC_A_TSTAMP, /* u64 reception time (ns, CLOCK_REALTIME) */
+    VMAC_A_STATS, /* nested, attribute i + 1 is u64 counter i of /proc/net/vmac/stats */
+    __VMAC_A_MAX,
+};
+#define VMAC_A_MAX (__VMAC_A_MAX - 1)
+
+/* generic netlink functions */
+int vmac_genl_init(void);
+void vmac_genl_exit(void);
+struct sk_buff* vmac_genl_new(u8 type, u64 enc, u32 len, gfp_t gfp, u32 port, u8 **data);
+bool vmac_genl_msg(const struct sk_buff *skb);
+void vmac_genl_send(struct sk_buff *skb);
+void vmac_genl_rx(struct sk_buff *skb, u64 enc, u8 type, u16 seq, u32 port);
+void vmac_genl_event(u8 type, u64 enc, const void *data, u16 len);
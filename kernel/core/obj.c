@@ -0,0 +1,330 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include "vmac.h"
+/*
+ * Object mode: segments of objects (VMAC_HDR_DATA_SEG) are held per encoding
+ * until the whole object arrived, holes being repaired by DACKs as usual, or
+ * the deadline of the encoding passed. The object then goes to userspace as one
+ * VMAC_OBJECT message instead of one message per frame.
+ */
+
+static unsigned int vmac_obj_kb = 4096;
+module_param(vmac_obj_kb, uint, 0644);
+MODULE_PARM_DESC(vmac_obj_kb, "Memory (KB) of frames held for object reassembly, larger objects are delivered frame by frame");
+
+/* largest object one raw netlink message can carry: obj_deliver allocates
+ * nlmsg_new(sizeof(struct vmac_object) + len + 115), which must stay a kmalloc */
+#define OBJ_NL_MAX (SKB_WITH_OVERHEAD(KMALLOC_MAX_SIZE) - NLMSG_HDRLEN - NLMSG_ALIGNTO - 115 - sizeof(struct vmac_object))
+
+struct vmac_obj
+{
+    struct list_head list; /* obj_list, oldest first */
+    u64 enc;
+    u32 id;
+    u32 len;
+    u16 mtu;
+    u16 count;
+    u16 got;
+    u8 flush; /* deliver now even if incomplete */
+    unsigned long deadline; /* jiffies */
+    long bytes; /* truesize of held frames and size of seg array */
+    struct sk_buff **seg; /* count frames, payload at data (FCS not counted) */
+};
+
+static LIST_HEAD(obj_list);
+static DEFINE_SPINLOCK(obj_lock); /* obj_list, objects and obj_done of rx entries */
+static long obj_bytes; /* bytes of all objects */
+
+static void obj_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(obj_work, obj_work_fn);
+
+static void obj_free(struct vmac_obj *o)
+{
+    u16 i;
+    for (i = 0; i < o->count; i++)
+    {
+        if (o->seg[i])
+            kfree_skb(o->seg[i]);
+    }
+    kfree(o->seg);
+    kfree(o);
+}
+
+static struct vmac_obj* obj_find(u64 enc, u32 id)
+{
+    struct vmac_obj *o;
+    list_for_each_entry(o, &obj_list, list)
+    {
+        if (o->enc == enc && o->id == id)
+            return o;
+    }
+    return NULL;
+}
+
+/**
+ * @brief      run delivery work at deadline unless it already runs earlier. Caller holds obj_lock.
+ */
+static void obj_arm(unsigned long deadline)
+{
+    unsigned long delay = time_after(deadline, jiffies) ? deadline - jiffies : 0;
+    if (!delayed_work_pending(&obj_work) || time_before(deadline, obj_work.timer.expires))
+        mod_delayed_work(system_wq, &obj_work, delay);
+}
+
+/**
+ * @brief      Take received object segment if encoding is in object mode
+ *
+ * @param      vmacr  The receiving entry (valid within RCU read section of vmac_rx)
+ * @param      seg    segment header, already pulled from frame
+ * @param      skb    frame, data pointing at segment payload followed by FCS
+ *
+ * @return     0 if frame was taken, otherwise caller delivers it as a single data frame
+ *
+ * @code{.unparsed}
+ *  If object mode off, segment header inconsistent, object or its segment array
+ *  larger than vmac_obj_kb, or object larger than one message to consumer can
+ *  carry (one attribute for generic netlink, one kmalloc for raw netlink)
+ *   return not taken //delivered frame by frame
+ *  End If
+ *  lock object list
+ *  find object
+ *  If not held and object (or a later one) already delivered
+ *   drop frame //late retransmission
+ *  End If
+ *  create object with deadline of encoding if new, account its segment array
+ *  store frame in its slot unless already there
+ *  If all segments in
+ *   mark object to be flushed and run delivery work now
+ *  End If
+ *  While frames held above vmac_obj_kb
+ *   flush oldest object (delivered partial)
+ *  End While
+ *  unlock object list
+ * @endcode
+ */
+int obj_rx(struct encoding_rx *vmacr, const struct vmac_seg *seg, struct sk_buff *skb)
+{
+    struct vmac_obj *o, *old;
+    u32 deadline = READ_ONCE(vmacr->obj_deadline);
+    u32 count, seglen;
+    long limit = (long)READ_ONCE(vmac_obj_kb) * 1024;
+    u8 genl;
+    if (!deadline || !seg->mtu || !seg->len || seg->len > limit || skb->len < 4)
+        return -1;
+    if (vmac_app_port(vmacr->key, VMAC_OBJECT, &genl))
+    {
+        if (genl && seg->len + sizeof(struct vmac_object) > U16_MAX - NLA_HDRLEN)
+            return -1; /* does not fit one generic netlink attribute */
+        if (!genl && seg->len > OBJ_NL_MAX)
+            return -1;
+    }
+    count = DIV_ROUND_UP(seg->len, seg->mtu);
+    if (count > U16_MAX || seg->idx >= count || (long)(count * sizeof(struct sk_buff*)) > limit)
+        return -1;
+    seglen = seg->idx + 1 < count ? seg->mtu : seg->len - (u32)seg->idx * seg->mtu;
+    if (skb->len - 4 != seglen)
+        return -1;
+    spin_lock(&obj_lock);
+    o = obj_find(vmacr->key, seg->id);
+    if (!o && vmacr->obj_seen && (s32)(seg->id - vmacr->obj_done) <= 0)
+    {
+        spin_unlock(&obj_lock);
+        kfree_skb(skb);
+        return 0;
+    }
+    if (o && (o->len != seg->len || o->mtu != seg->mtu))
+    {
+        spin_unlock(&obj_lock);
+        return -1;
+    }
+    if (!o)
+    {
+        o = kzalloc(sizeof(struct vmac_obj), GFP_ATOMIC);
+        if (o)
+            o->seg = kcalloc(count, sizeof(struct sk_buff*), GFP_ATOMIC);
+        if (!o || !o->seg)
+        {
+            kfree(o);
+            spin_unlock(&obj_lock);
+            vmac_stat_inc(vmacr->stats, VMAC_STAT_ALLOC_FAIL);
+            return -1;
+        }
+        o->enc = vmacr->key;
+        o->id = seg->id;
+        o->len = seg->len;
+        o->mtu = seg->mtu;
+        o->count = count;
+        o->bytes = count * sizeof(struct sk_buff*);
+        obj_bytes += o->bytes;
+        o->deadline = jiffies + deadline;
+        list_add_tail(&o->list, &obj_list);
+        obj_arm(o->deadline);
+    }
+    if (o->seg[seg->idx])
+    {
+        kfree_skb(skb);
+    }
+    else
+    {
+        o->seg[seg->idx] = skb;
+        o->got++;
+        o->bytes += skb->truesize;
+        obj_bytes += skb->truesize;
+    }
+    if (o->got == o->count)
+    {
+        o->flush = 1;
+        obj_arm(jiffies);
+    }
+    list_for_each_entry(old, &obj_list, list)
+    {
+        if (obj_bytes <= limit)
+            break;
+        if (!old->flush)
+        {
+            old->flush = 1;
+            obj_bytes -= old->bytes;
+            old->bytes = 0;
+            obj_arm(jiffies);
+        }
+    }
+    spin_unlock(&obj_lock);
+    return 0;
+}
+
+/**
+ * @brief      Send object to userspace: struct vmac_object followed by object,
+ * missing segments zero filled
+ */
+static void obj_deliver(struct vmac_obj *o)
+{
+    struct vmac_object hdr;
+    struct sk_buff *skb_out;
+    u16 i, missing = o->count - o->got;
+    u32 n;
+    u8 *p;
+    skb_out = vmac_nl_new(VMAC_OBJECT, o->enc, sizeof(struct vmac_object) + o->len, GFP_KERNEL, &p);
+    if (!skb_out)
+    {
+        vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+        return;
+    }
+    memcpy(&hdr.id[0], &o->id, 4);
+    memcpy(&hdr.len[0], &o->len, 4);
+    memcpy(&hdr.missing[0], &missing, 2);
+    hdr.flags[0] = missing ? VMAC_OBJ_PARTIAL : 0;
+    memcpy(p, &hdr, sizeof(struct vmac_object));
+    p += sizeof(struct vmac_object);
+    for (i = 0; i < o->count; i++, p += n)
+    {
+        n = i + 1 < o->count ? o->mtu : o->len - (u32)i * o->mtu;
+        if (o->seg[i])
+            memcpy(p, o->seg[i]->data, n);
+        else
+            memset(p, 0, n);
+    }
+    vmac_stat_inc(NULL, missing ? VMAC_STAT_OBJ_PARTIAL : VMAC_STAT_OBJ_RX);
+    vmac_nl_unicast(skb_out);
+}
+
+/**
+ * @brief      Deliver complete, flushed and expired objects, then re-arm for the
+ * earliest remaining deadline
+ *
+ * @code{.unparsed}
+ *  lock object list
+ *  for each object
+ *   If complete, flushed or past deadline
+ *    move to local list, release its memory accounting
+ *    remember it as last object delivered for its encoding
+ *   else
+ *    track earliest deadline
+ *   End If
+ *  End For
+ *  re-arm for earliest deadline
+ *  unlock object list
+ *  deliver and free objects in local list
+ * @endcode
+ */
+static void obj_work_fn(struct work_struct *work)
+{
+    LIST_HEAD(out);
+    struct vmac_obj *o, *tmp;
+    struct encoding_rx *vmacr;
+    unsigned long next = 0;
+    bool more = false;
+    rcu_read_lock();
+    spin_lock_bh(&obj_lock);
+    list_for_each_entry_safe(o, tmp, &obj_list, list)
+    {
+        if (!o->flush && time_before(jiffies, o->deadline))
+        {
+            if (!more || time_before(o->deadline, next))
+                next = o->deadline;
+            more = true;
+            continue;
+        }
+        list_move_tail(&o->list, &out);
+        obj_bytes -= o->bytes;
+        vmacr = find_rx(RX_TABLE, o->enc);
+        if (vmacr && (!vmacr->obj_seen || (s32)(o->id - vmacr->obj_done) > 0))
+        {
+            vmacr->obj_done = o->id;
+            vmacr->obj_seen = 1;
+        }
+    }
+    if (more)
+        obj_arm(next);
+    spin_unlock_bh(&obj_lock);
+    rcu_read_unlock();
+    list_for_each_entry_safe(o, tmp, &out, list)
+    {
+        obj_deliver(o);
+        obj_free(o);
+    }
+}
+
+/**
+ * @brief      Set object mode of encoding (VMAC_CONFIG_OBJECT)
+ *
+ * @param[in]  enc   The encoding
+ * @param[in]  ms    time an incomplete object waits before partial delivery, 0 turns object mode off
+ * NOTE: applies to state kernel holds, i.e. after the first interest was sent
+ */
+void vmac_set_object(u64 enc, u32 ms)
+{
+    struct encoding_rx *vmacr;
+    rcu_read_lock();
+    vmacr = find_rx(RX_TABLE, enc);
+    if (vmacr)
+        WRITE_ONCE(vmacr->obj_deadline, ms ? max_t(unsigned long, msecs_to_jiffies(ms), 1) : 0);
+    rcu_read_unlock();
+}
+
+/**
+ * @brief      Stop delivery work and drop objects still held
+ */
+void obj_stop(void)
+{
+    struct vmac_obj *o, *tmp;
+    cancel_delayed_work_sync(&obj_work);
+    spin_lock_bh(&obj_lock);
+    list_for_each_entry_safe(o, tmp, &obj_list, list)
+    {
+        list_del(&o->list);
+        obj_free(o);
+    }
+    obj_bytes = 0;
+    spin_unlock_bh(&obj_lock);
+}
@@ -0,0 +1,22 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+
+struct sk_buff;
+struct encoding_rx;
+struct vmac_seg;
+
+/* object mode functions */
+int obj_rx(struct encoding_rx *vmacr, const struct vmac_seg *seg, struct sk_buff *skb);
+void vmac_set_object(u64 enc, u32 ms);
+void obj_stop(void);
@@ -0,0 +1,194 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+#include "vmac.h"
+
+/**
+ * Rate ladder ordered by nominal PHY rate: mcs, bw (0=20MHz, 1=40MHz), sgi, stream
+ * (same encoding as the rates[] table in the userspace library).
+ */
+static const struct {
+    u8 mcs;
+    u8 bw;
+    u8 sgi;
+    u8 stream;
+} rate_ladder[] = {
+    {0, 0, 0, 0}, /* 6.5 Mbps */
+    {1, 0, 0, 0}, /* 13 */
+    {2, 0, 0, 0}, /* 19.5 */
+    {3, 0, 0, 0}, /* 26 */
+    {4, 0, 0, 0}, /* 39 */
+    {3, 1, 0, 0}, /* 54 */
+    {3, 1, 1, 0}, /* 60 */
+    {4, 1, 0, 0}, /* 81 */
+    {5, 1, 0, 0}, /* 108 */
+    {6, 1, 0, 0}, /* 121.5 */
+    {7, 1, 1, 0}, /* 150 */
+    {4, 1, 0, 1}, /* 162 */
+    {5, 1, 0, 1}, /* 216 */
+    {6, 1, 0, 1}, /* 243 */
+    {7, 1, 1, 1}, /* 300 */
+};
+
+/**
+ * @brief      Init rate decision of a new tx encoding
+ *
+ * @param      decis  The rate decision
+ */
+void rate_init(struct rate_decision *decis)
+{
+    decis->rate_idx[0] = RATE_START_IDX;
+    decis->rate_idx[1] = 0;
+    decis->rate_idx[2] = ARRAY_SIZE(rate_ladder);
+    decis->rate = 0;
+    decis->round = 0;
+}
+
+/**
+ * @brief      Fill PHY parameters from the current ladder entry of an encoding
+ *
+ * @param      vmact   The tx encoding
+ * @param      rate    mcs index
+ * @param      bw      bandwidth
+ * @param      sgi     short guard interval
+ * @param      stream  spatial stream
+ */
+void rate_get(struct encoding_tx *vmact, u8 *rate, u8 *bw, u8 *sgi, u8 *stream)
+{
+    u8 idx = READ_ONCE(vmact->decis.rate_idx[0]);
+    *rate = rate_ladder[idx].mcs;
+    *bw = rate_ladder[idx].bw;
+    *sgi = rate_ladder[idx].sgi;
+    *stream = rate_ladder[idx].stream;
+}
+
+/**
+ * @brief      Length of the loss measurement range of a DACK round, shorter
+ * for the first rounds of an encoding (and right after its sequence wraps)
+ */
+static u16 rate_span(u16 round)
+{
+    return round_seq(round) < RATE_EVAL_SEQS ? round_seq(round) : RATE_EVAL_SEQS;
+}
+
+/**
+ * @brief      Number of sequences of hole [le, re) within the loss
+ * measurement range of a DACK round, i.e. [round_seq - rate_span, round_seq)
+ *
+ * @param[in]  le     left edge of hole
+ * @param[in]  re     right edge of hole (exclusive)
+ * @param[in]  round  DACK round
+ *
+ * @return     lost sequences counted toward rate adaptation
+ */
+u16 rate_overlap(u16 le, u16 re, u16 round)
+{
+    u16 hi = round_seq(round);
+    u16 lo = hi - rate_span(round);
+    if (seq_before(le, lo))
+        le = lo;
+    if (seq_after(re, hi))
+        re = hi;
+    return seq_after(re, le) ? (u16)(re - le) : 0;
+}
+
+/**
+ * @brief      Feed loss reported by one DACK into the encoding rate decision
+ * (receive softirq, several CPUs at once)
+ *
+ * @param      vmact  The tx encoding
+ * @param[in]  round  DACK round
+ * @param[in]  lost   lost sequences in the measurement range (see rate_overlap)
+ *
+ * @code{.unparsed}
+ * compute loss percentage over measurement range
+ * lock encoding (DACKs of several receivers are handled in parallel)
+ * if DACK belongs to round being accumulated
+ *  keep worst loss reported (i.e. worst-served receiver)
+ *  unlock and return
+ * End If
+ * if DACK belongs to an older round (late receiver)
+ *  unlock and return //that round was already evaluated
+ * End If
+ * evaluate worst loss of finished round:
+ * if loss >= RATE_LOSS_DOWN
+ *  step one ladder entry down and remember failed entry as probe ceiling
+ * else if loss <= RATE_LOSS_UP
+ *  count clean round, current entry becomes last stable
+ *  if enough clean rounds (4x more when next entry is the failed ceiling)
+ *   step one ladder entry up
+ * else
+ *  hold rate and reset clean rounds
+ * End If
+ * start accumulating new round
+ * unlock encoding
+ * @endcode
+ */
+void rate_update(struct encoding_tx *vmact, u16 round, u16 lost)
+{
+    struct rate_decision *decis = &vmact->decis;
+    u16 span = rate_span(round);
+    u8 loss, idx, need;
+    if (span == 0)
+        return;
+    loss = lost >= span ? 100 : (lost * 100) / span;
+    spin_lock(&vmact->seqlock);
+    if (round == decis->round)
+    {
+        if (loss > decis->rate)
+            decis->rate = loss;
+        spin_unlock(&vmact->seqlock);
+        return;
+    }
+    if (seq_before(round_seq(round), round_seq(decis->round)))
+    {
+        spin_unlock(&vmact->seqlock);
+        return;
+    }
+    idx = decis->rate_idx[0];
+    if (decis->rate >= RATE_LOSS_DOWN)
+    {
+        vmact->round_inc = 0;
+        vmact->round_dec++;
+        if (idx > 0)
+        {
+            decis->rate_idx[2] = idx;
+            idx--;
+        }
+    }
+    else if (decis->rate <= RATE_LOSS_UP)
+    {
+        vmact->round_dec = 0;
+        vmact->round_inc++;
+        decis->rate_idx[1] = idx;
+        need = (idx + 1 >= decis->rate_idx[2]) ? RATE_ROUNDS_UP * 4 : RATE_ROUNDS_UP;
+        if (vmact->round_inc >= need && idx + 1 < ARRAY_SIZE(rate_ladder))
+        {
+            vmact->round_inc = 0;
+            if (idx + 1 >= decis->rate_idx[2])
+                decis->rate_idx[2] = ARRAY_SIZE(rate_ladder);
+            idx++;
+        }
+    }
+    else
+    {
+        vmact->round_inc = 0;
+    }
+    #ifdef DEBUG_MO
+        printk(KERN_INFO "VMAC_RATE: enc %llu round %u loss %u%% ladder %u -> %u\n", vmact->key, decis->round, decis->rate, decis->rate_idx[0], idx);
+    #endif
+    WRITE_ONCE(decis->rate_idx[0], idx);
+    decis->round = round;
+    decis->rate = loss;
+    spin_unlock(&vmact->seqlock);
+}
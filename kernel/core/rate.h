@@ -0,0 +1,30 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+
+/* Defines ********************************************************************/
+#define VMAC_RATE_AUTO 255  /* rate value from userspace selecting kernel rate adaptation */
+#define RATE_START_IDX 6    /* ladder entry used before any DACK is heard (60 Mbps) */
+#define RATE_EVAL_SEQS 50   /* sequences before a DACK round used to measure loss */
+#define RATE_LOSS_DOWN 10   /* percent loss in a round that steps rate down */
+#define RATE_LOSS_UP 2      /* percent loss at or below which a round is clean */
+#define RATE_ROUNDS_UP 8    /* clean rounds before probing the next rate */
+
+struct encoding_tx;
+struct rate_decision;
+
+/* rate adaptation functions */
+void rate_init(struct rate_decision *decis);
+void rate_get(struct encoding_tx *vmact, u8 *rate, u8 *bw, u8 *sgi, u8 *stream);
+void rate_update(struct encoding_tx *vmact, u16 round, u16 lost);
+u16 rate_overlap(u16 le, u16 re, u16 round);
@@ -0,0 +1,358 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include "vmac.h"
+/*
+ * In-order delivery: data frames of an encoding in this mode are held until
+ * the frames before them were delivered, so the consumer gets them in sequence
+ * order. Contiguous runs go out as soon as their first frame arrives. A hole
+ * blocks delivery until the deadline of the encoding passed since the first
+ * frame behind it arrived (or ORD_WINDOW frames are held), then it is skipped
+ * and the consumer gets a VMAC_GAP message. Frames of a skipped hole arriving
+ * later (e.g. retransmissions answering DACKs) are dropped.
+ */
+
+struct vmac_ord
+{
+    struct list_head list; /* ord_list */
+    struct encoding_rx *vmacr; /* owner, valid while on ord_list (reorder_forget unlinks first) */
+    u64 enc;
+    u16 next; /* next sequence to deliver */
+    u16 held;
+    struct sk_buff *buf[ORD_WINDOW]; /* slot seq % ORD_WINDOW, payload at data */
+    unsigned long at[ORD_WINDOW]; /* jiffies frame of slot arrived */
+};
+
+static LIST_HEAD(ord_list);
+static DEFINE_SPINLOCK(ord_lock); /* ord_list, entries and encoding_rx ord/ord_dead, held while delivering so frames keep their order */
+
+static void ord_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ord_work, ord_work_fn);
+
+/**
+ * @brief      run deadline work at deadline unless it already runs earlier. Caller holds ord_lock.
+ */
+static void ord_arm(unsigned long deadline)
+{
+    unsigned long delay = time_after(deadline, jiffies) ? deadline - jiffies : 0;
+    if (!delayed_work_pending(&ord_work) || time_before(deadline, ord_work.timer.expires))
+        mod_delayed_work(system_wq, &ord_work, delay);
+}
+
+/**
+ * @brief      Send struct vmac_gap to consumer of encoding. Caller holds ord_lock.
+ */
+static void ord_gap(struct vmac_ord *o, u16 first, u16 count)
+{
+    struct vmac_gap gap;
+    struct sk_buff *skb_out;
+    u8 *p;
+    vmac_stat_add(NULL, VMAC_STAT_ORD_GAP, count);
+    skb_out = vmac_nl_new(VMAC_GAP, o->enc, sizeof(struct vmac_gap), GFP_ATOMIC, &p);
+    if (!skb_out)
+        return;
+    memcpy(&gap.first[0], &first, 2);
+    memcpy(&gap.count[0], &count, 2);
+    memcpy(p, &gap, sizeof(struct vmac_gap));
+    vmac_nl_unicast(skb_out);
+}
+
+/**
+ * @brief      Deliver contiguous run of held frames starting at next. Caller holds ord_lock.
+ */
+static void ord_release(struct vmac_ord *o)
+{
+    struct sk_buff *skb;
+    while ((skb = o->buf[o->next % ORD_WINDOW]) != NULL)
+    {
+        o->buf[o->next % ORD_WINDOW] = NULL;
+        o->held--;
+        nl_send(skb, o->enc, VMAC_HDR_DATA, o->next);
+        o->next++;
+    }
+}
+
+/**
+ * @brief      Deliver held frames before sequence to, skipping holes, then the
+ * run following it. Caller holds ord_lock.
+ *
+ * @code{.unparsed}
+ *  while next before to
+ *   If frame of next held
+ *    deliver it
+ *   else
+ *    skip hole up to next held frame or to
+ *    send gap message for skipped sequences
+ *   End If
+ *  End While
+ *  deliver contiguous run at next
+ * @endcode
+ */
+static void ord_advance(struct vmac_ord *o, u16 to)
+{
+    u16 first;
+    while (seq_before(o->next, to))
+    {
+        if (o->buf[o->next % ORD_WINDOW])
+        {
+            ord_release(o);
+            continue;
+        }
+        first = o->next;
+        while (seq_before(o->next, to) && !o->buf[o->next % ORD_WINDOW])
+            o->next++;
+        ord_gap(o, first, o->next - first);
+    }
+    ord_release(o);
+}
+
+/**
+ * @brief      sequence of first held frame, o->held must be nonzero
+ */
+static u16 ord_first(struct vmac_ord *o)
+{
+    u16 seq = o->next;
+    while (!o->buf[seq % ORD_WINDOW])
+        seq++;
+    return seq;
+}
+
+/**
+ * @brief      Sequence in-order delivery of new reorder entry starts at: first
+ * one after the last frame received before seq (e.g. frame being repaired),
+ * seq itself if none was received in the ORD_WINDOW frames before it
+ *
+ * @param      vmacr  The receiving entry, seq already marked received in its window
+ * @param[in]  seq    first frame taken in in-order mode
+ */
+static u16 ord_start(struct encoding_rx *vmacr, u16 seq)
+{
+    u16 s, i;
+    for (i = 1; i < ORD_WINDOW; i++)
+    {
+        s = seq - i;
+        if ((u16)(vmacr->latest - s) >= WINDOW)
+            break;
+        if (test_bit(s % WINDOW, vmacr->window))
+            return s + 1;
+    }
+    return seq;
+}
+
+/**
+ * @brief      Deliver held frames and free reorder entry. Caller holds ord_lock.
+ */
+static void ord_free(struct vmac_ord *o)
+{
+    while (o->held)
+        ord_advance(o, ord_first(o));
+    o->vmacr->ord = NULL;
+    list_del(&o->list);
+    kfree(o);
+}
+
+/**
+ * @brief      Take received data frame if encoding is in in-order mode
+ *
+ * @param      vmacr  The receiving entry (valid within RCU read section of vmac_rx)
+ * @param      skb    frame, data pointing at payload followed by FCS
+ * @param[in]  seq    The sequence number
+ *
+ * @return     0 if frame was taken (delivered, held or dropped), otherwise caller delivers it
+ *
+ * @code{.unparsed}
+ *  If in-order mode off or object mode on
+ *   return not taken
+ *  End If
+ *  lock reorder list
+ *  If entry is being freed
+ *   return not taken
+ *  End If
+ *  create reorder entry if new, starting after last frame received before seq
+ *  If seq before next sequence to deliver
+ *   drop frame //its hole was skipped
+ *  End If
+ *  If seq ORD_WINDOW or more ahead of next
+ *   deliver or skip frames up to seq - ORD_WINDOW + 1
+ *  End If
+ *  hold frame, noting arrival time
+ *  deliver contiguous run at next
+ *  If frames still held
+ *   run deadline work at deadline of frame
+ *  End If
+ *  unlock reorder list
+ * @endcode
+ */
+int reorder_rx(struct encoding_rx *vmacr, struct sk_buff *skb, u16 seq)
+{
+    struct vmac_ord *o;
+    u32 deadline = READ_ONCE(vmacr->ord_deadline);
+    if (!deadline || READ_ONCE(vmacr->obj_deadline))
+        return -1;
+    spin_lock(&ord_lock);
+    if (vmacr->ord_dead)
+    {
+        spin_unlock(&ord_lock);
+        return -1;
+    }
+    o = vmacr->ord;
+    if (!o)
+    {
+        o = kzalloc(sizeof(struct vmac_ord), GFP_ATOMIC);
+        if (!o)
+        {
+            spin_unlock(&ord_lock);
+            vmac_stat_inc(vmacr->stats, VMAC_STAT_ALLOC_FAIL);
+            return -1;
+        }
+        o->vmacr = vmacr;
+        o->enc = vmacr->key;
+        o->next = ord_start(vmacr, seq);
+        list_add_tail(&o->list, &ord_list);
+        vmacr->ord = o;
+    }
+    if (seq_before(seq, o->next) || o->buf[seq % ORD_WINDOW])
+    {
+        spin_unlock(&ord_lock);
+        vmac_stat_inc(vmacr->stats, VMAC_STAT_ORD_LATE);
+        kfree_skb(skb);
+        return 0;
+    }
+    if ((u16)(seq - o->next) >= ORD_WINDOW)
+        ord_advance(o, seq - ORD_WINDOW + 1);
+    o->buf[seq % ORD_WINDOW] = skb;
+    o->at[seq % ORD_WINDOW] = jiffies;
+    o->held++;
+    ord_release(o);
+    if (o->held)
+        ord_arm(jiffies + deadline);
+    spin_unlock(&ord_lock);
+    return 0;
+}
+
+/**
+ * @brief      Skip holes whose deadline passed, flush encodings that left
+ * in-order mode, then re-arm for the earliest remaining deadline
+ *
+ * @code{.unparsed}
+ *  lock reorder list
+ *  for each reorder entry
+ *   If in-order mode turned off
+ *    deliver held frames, free entry
+ *   else
+ *    while first held frame waited past deadline
+ *     skip hole before it, deliver run
+ *    End While
+ *    track deadline of first held frame
+ *   End If
+ *  End For
+ *  re-arm for earliest deadline
+ *  unlock reorder list
+ * @endcode
+ */
+static void ord_work_fn(struct work_struct *work)
+{
+    struct vmac_ord *o, *tmp;
+    unsigned long next = 0, due;
+    bool more = false;
+    u32 deadline;
+    u16 first;
+    spin_lock_bh(&ord_lock);
+    list_for_each_entry_safe(o, tmp, &ord_list, list)
+    {
+        deadline = READ_ONCE(o->vmacr->ord_deadline);
+        if (!deadline)
+        {
+            ord_free(o);
+            continue;
+        }
+        while (o->held)
+        {
+            first = ord_first(o);
+            due = o->at[first % ORD_WINDOW] + deadline;
+            if (time_before(jiffies, due))
+            {
+                if (!more || time_before(due, next))
+                    next = due;
+                more = true;
+                break;
+            }
+            ord_advance(o, first);
+        }
+    }
+    if (more)
+        ord_arm(next);
+    spin_unlock_bh(&ord_lock);
+}
+
+/**
+ * @brief      Set in-order mode of encoding (VMAC_CONFIG_ORDER)
+ *
+ * @param[in]  enc   The encoding
+ * @param[in]  ms    time a hole may block delivery before it is skipped, 0 turns in-order mode off
+ * NOTE: applies to state kernel holds, i.e. after the first interest was sent
+ */
+void vmac_set_reorder(u64 enc, u32 ms)
+{
+    struct encoding_rx *vmacr;
+    rcu_read_lock();
+    vmacr = find_rx(RX_TABLE, enc);
+    if (vmacr)
+        WRITE_ONCE(vmacr->ord_deadline, ms ? max_t(unsigned long, msecs_to_jiffies(ms), 1) : 0);
+    rcu_read_unlock();
+    if (!ms)
+    {
+        /* deliver what is held and free reorder entry */
+        spin_lock_bh(&ord_lock);
+        ord_arm(jiffies);
+        spin_unlock_bh(&ord_lock);
+    }
+}
+
+/**
+ * @brief      Receiving entry is being freed (GC or unload): deliver frames it
+ * still holds, free its reorder entry and keep a new one from being created
+ *
+ * @param      vmacr  The receiving entry, already removed from rx table
+ */
+void reorder_forget(struct encoding_rx *vmacr)
+{
+    spin_lock_bh(&ord_lock);
+    vmacr->ord_dead = 1;
+    if (vmacr->ord)
+        ord_free(vmacr->ord);
+    spin_unlock_bh(&ord_lock);
+}
+
+/**
+ * @brief      Stop deadline work and drop frames still held
+ */
+void reorder_stop(void)
+{
+    struct vmac_ord *o, *tmp;
+    u16 i;
+    cancel_delayed_work_sync(&ord_work);
+    spin_lock_bh(&ord_lock);
+    list_for_each_entry_safe(o, tmp, &ord_list, list)
+    {
+        for (i = 0; i < ORD_WINDOW; i++)
+        {
+            if (o->buf[i])
+                kfree_skb(o->buf[i]);
+        }
+        o->vmacr->ord = NULL;
+        list_del(&o->list);
+        kfree(o);
+    }
+    spin_unlock_bh(&ord_lock);
+}
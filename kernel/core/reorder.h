@@ -0,0 +1,24 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+
+struct sk_buff;
+struct encoding_rx;
+
+#define ORD_WINDOW 256 /* frames held per encoding, must divide 2^16 (see WINDOW) */
+
+/* in-order delivery functions */
+int reorder_rx(struct encoding_rx *vmacr, struct sk_buff *skb, u16 seq);
+void vmac_set_reorder(u64 enc, u32 ms);
+void reorder_forget(struct encoding_rx *vmacr);
+void reorder_stop(void);
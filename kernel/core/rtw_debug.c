@@ -16,6 +16,7 @@
 
 #include <drv_types.h>
 #include <hal_data.h>
+#include "vmac.h"
 
 #ifdef CONFIG_RTW_DEBUG
 const char *rtw_log_level_str[] = {
@@ -824,6 +825,46 @@ int proc_get_tx_stat(struct seq_file *m, void *v)
 	return 0;
 }
 
+int proc_get_vmac_stat(struct seq_file *m, void *v)
+{
+	int i;
+
+	for (i = 0; i < VMAC_STAT_MAX; i++)
+		RTW_PRINT_SEL(m, "%-16s:\t%llu\n", vmac_stat_names[i], vmac_stat_sum(NULL, i));
+	return 0;
+}
+
+static void proc_vmac_enc_stat(struct seq_file *m, u64 enc, const char *role, struct vmac_stats __percpu *stats)
+{
+	u64 val;
+	int i;
+
+	RTW_PRINT_SEL(m, "enc :\t\t0x%016llx (%s)\n", enc, role);
+	for (i = 0; i < VMAC_STAT_MAX; i++) {
+		val = vmac_stat_sum(stats, i);
+		if (val)
+			RTW_PRINT_SEL(m, "%-16s:\t%llu\n", vmac_stat_names[i], val);
+	}
+	RTW_PRINT_SEL(m, "\n");
+}
+
+static void proc_vmac_rx_stat(struct encoding_rx *vmacr, void *arg)
+{
+	proc_vmac_enc_stat(arg, vmacr->key, "consumer", vmacr->stats);
+}
+
+static void proc_vmac_tx_stat(struct encoding_tx *vmact, void *arg)
+{
+	proc_vmac_enc_stat(arg, vmact->key, "producer", vmact->stats);
+}
+
+int proc_get_vmac_enc_stat(struct seq_file *m, void *v)
+{
+	walk_tx(proc_vmac_tx_stat, m);
+	walk_rx(proc_vmac_rx_stat, m);
+	return 0;
+}
+
 int proc_get_fwstate(struct seq_file *m, void *v)
 {
 	struct net_device *dev = m->private;
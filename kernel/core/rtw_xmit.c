@@ -20,8 +20,25 @@
 #include "vmac.h"
 #include "tx.h"
 
-DECLARE_HASHTABLE(rx_enc, 5);
-DECLARE_HASHTABLE(tx_enc, 5);
+static struct rhashtable rx_enc;
+static struct rhashtable tx_enc;
+static struct kmem_cache *rx_cache;
+static struct kmem_cache *tx_cache;
+static struct kmem_cache *retx_cache;
+
+static const struct rhashtable_params rx_enc_params = {
+    .key_len = sizeof(u64),
+    .key_offset = offsetof(struct encoding_rx, key),
+    .head_offset = offsetof(struct encoding_rx, node),
+    .automatic_shrinking = true,
+};
+
+static const struct rhashtable_params tx_enc_params = {
+    .key_len = sizeof(u64),
+    .key_offset = offsetof(struct encoding_tx, key),
+    .head_offset = offsetof(struct encoding_tx, node),
+    .automatic_shrinking = true,
+};
 struct sock *nl_sk = NULL;
 
 
@@ -30,23 +47,21 @@ const struct cfg80211_ops mac80211_config_ops = {
 
 _adapter *mon_adapter = NULL;
 
-int pidt;
 int configured = _FALSE;
 
+void vmac_send_hack(struct sk_buff* skb){
+	vmac_low_tx(skb, 0, 1, 0, 1, 0, mon_adapter);
+	
+}
 
 /**
- * @brief      returns PID of userspace process
+ * @brief      returns MAC address of the monitor adapter (receiver identity for DACK slots)
  *
- * @return     PID (int)
+ * @return     6-byte address
  */
-int getpidt(void)
+u8* vmac_get_addr(void)
 {
-    return pidt;
-}
-
-void vmac_send_hack(struct sk_buff* skb){
-	vmac_low_tx(skb, 0, 1, 0, 1, 0, mon_adapter);
-	
+    return adapter_mac_addr(mon_adapter);
 }
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24))
@@ -160,39 +175,385 @@ struct sock* getsock(void)
     return nl_sk;
 }
 
-struct encoding_tx* find_tx(int table, u64 enc)
+static void destroy_caches(void)
+{
+    kmem_cache_destroy(retx_cache);
+    kmem_cache_destroy(tx_cache);
+    kmem_cache_destroy(rx_cache);
+}
+
+/**
+ * @brief      Initialize encoding tables (LET), resizable and RCU protected, and
+ * slab caches for encoding entries
+ *
+ * @return     0 on success, negative errno otherwise
+ */
+int init_tables(void)
 {
-    struct encoding_tx *vmact, *ret = NULL;
-    hash_for_each_possible(tx_enc, vmact, node, enc)
+    int ret;
+    rx_cache = kmem_cache_create("vmac_enc_rx", sizeof(struct encoding_rx), 0, 0, NULL);
+    tx_cache = kmem_cache_create("vmac_enc_tx", sizeof(struct encoding_tx), 0, 0, NULL);
+    retx_cache = kmem_cache_create("vmac_retx", sizeof(struct retx_chunk), 0, 0, NULL);
+    if (!rx_cache || !tx_cache || !retx_cache)
     {
-        ret = vmact;
+        destroy_caches();
+        return -ENOMEM;
     }
+    ret = rhashtable_init(&rx_enc, &rx_enc_params);
+    if (ret)
+        goto caches;
+    ret = rhashtable_init(&tx_enc, &tx_enc_params);
+    if (ret)
+        goto rx;
+    return 0;
+rx:
+    rhashtable_destroy(&rx_enc);
+caches:
+    destroy_caches();
     return ret;
 }
-void add_rx(struct encoding_rx *vmacr)
+
+/**
+ * @brief      allocate zeroed receiving entry
+ *
+ * @return     entry or NULL
+ */
+struct encoding_rx* alloc_rx(gfp_t gfp)
+{
+    struct encoding_rx *vmacr = kmem_cache_zalloc(rx_cache, gfp);
+    if (!vmacr)
+        return NULL;
+    vmacr->stats = alloc_percpu_gfp(struct vmac_stats, gfp);
+    if (!vmacr->stats)
+    {
+        kmem_cache_free(rx_cache, vmacr);
+        return NULL;
+    }
+    return vmacr;
+}
+
+/**
+ * @brief      allocate zeroed transmission entry, retransmission buffer is
+ * allocated by retx_chunk_get as frames are sent
+ *
+ * @return     entry or NULL
+ */
+struct encoding_tx* alloc_tx(gfp_t gfp)
+{
+    struct encoding_tx *vmact = kmem_cache_zalloc(tx_cache, gfp);
+    if (!vmact)
+        return NULL;
+    vmact->stats = alloc_percpu_gfp(struct vmac_stats, gfp);
+    if (!vmact->stats)
+    {
+        kmem_cache_free(tx_cache, vmact);
+        return NULL;
+    }
+    return vmact;
+}
+
+void free_rx(struct encoding_rx *vmacr)
+{
+    free_percpu(vmacr->stats);
+    kmem_cache_free(rx_cache, vmacr);
+}
+
+/**
+ * @brief      free transmission entry together with buffered frames
+ */
+void free_tx(struct encoding_tx *vmact)
+{
+    int i, j;
+    for (i = 0; i < RETX_CHUNKS; i++)
+    {
+        if (!vmact->retx[i])
+            continue;
+        for (j = 0; j < RETX_CHUNK; j++)
+        {
+            retx_free(vmact->retx[i]->buf[j]);
+        }
+        kmem_cache_free(retx_cache, vmact->retx[i]);
+    }
+    free_percpu(vmact->stats);
+    kmem_cache_free(tx_cache, vmact);
+}
+
+/* rhashtable_free_and_destroy callbacks (vmac_exit), tables no longer in use */
+static void free_rx_entry(void *ptr, void *arg)
+{
+    struct encoding_rx *vmacr = ptr;
+    dack_forget(vmacr);
+    reorder_forget(vmacr);
+    free_rx(vmacr);
+}
+
+static void free_tx_entry(void *ptr, void *arg)
+{
+    struct encoding_tx *vmact = ptr;
+    budget_untrack(vmact);
+    free_tx(vmact);
+}
+
+/**
+ * @brief      retransmission chunk holding slot of seq, allocated on first use.
+ * Chunks stay until the entry is freed so readers never race a resize.
+ *
+ * @return     chunk or NULL on allocation failure
+ */
+struct retx_chunk* retx_chunk_get(struct encoding_tx *vmact, u16 seq, gfp_t gfp)
+{
+    struct retx_chunk *chunk = retx_chunk(vmact, seq), *old;
+    if (chunk)
+        return chunk;
+    chunk = kmem_cache_zalloc(retx_cache, gfp);
+    if (!chunk)
+        return NULL;
+    old = cmpxchg(&vmact->retx[(seq % WINDOW_TX) / RETX_CHUNK], NULL, chunk);
+    if (old)
+    {
+        kmem_cache_free(retx_cache, chunk);
+        return old;
+    }
+    return chunk;
+}
+
+/**
+ * @brief      look up transmission entry, caller must hold rcu_read_lock
+ *
+ * @param[in]  table  The table
+ * @param[in]  enc    The encoding
+ *
+ * @return     entry or NULL
+ */
+struct encoding_tx* find_tx(int table, u64 enc)
+{
+    return rhashtable_lookup_fast(&tx_enc, &enc, tx_enc_params);
+}
+
+/**
+ * @brief      insert receiving entry
+ *
+ * @return     0 on success, -EEXIST if encoding already present, other negative errno on failure
+ */
+int add_rx(struct encoding_rx *vmacr)
+{
+    return rhashtable_lookup_insert_fast(&rx_enc, &vmacr->node, rx_enc_params);
+}
+
+/**
+ * @brief      insert transmission entry
+ *
+ * @return     0 on success, -EEXIST if encoding already present, other negative errno on failure
+ */
+int add_tx(struct encoding_tx *vmact)
+{
+    return rhashtable_lookup_insert_fast(&tx_enc, &vmact->node, tx_enc_params);
+}
+
+/**
+ * @brief      remove receiving entry, entry must only be freed after an RCU grace period
+ */
+int del_rx(struct encoding_rx *vmacr)
+{
+    return rhashtable_remove_fast(&rx_enc, &vmacr->node, rx_enc_params);
+}
+
+/**
+ * @brief      remove transmission entry, entry must only be freed after an RCU grace period
+ */
+int del_tx(struct encoding_tx *vmact)
+{
+    return rhashtable_remove_fast(&tx_enc, &vmact->node, tx_enc_params);
+}
+
+/**
+ * @brief      call fn on every receiving entry, fn runs within RCU read section
+ * and may remove the entry. Entries moved by a concurrent resize may be visited twice or missed.
+ */
+void walk_rx(void (*fn)(struct encoding_rx*, void*), void *arg)
 {
-    hash_add(rx_enc, &vmacr->node, vmacr->key);
+    struct rhashtable_iter iter;
+    struct encoding_rx *vmacr;
+    rhashtable_walk_enter(&rx_enc, &iter);
+    rhashtable_walk_start(&iter);
+    while ((vmacr = rhashtable_walk_next(&iter)) != NULL)
+    {
+        if (IS_ERR(vmacr))
+            continue; /* -EAGAIN: table resized, walk continues */
+        fn(vmacr, arg);
+    }
+    rhashtable_walk_stop(&iter);
+    rhashtable_walk_exit(&iter);
 }
 
-void add_tx(struct encoding_tx *vmact)
+/**
+ * @brief      call fn on every transmission entry, same rules as walk_rx
+ */
+void walk_tx(void (*fn)(struct encoding_tx*, void*), void *arg)
 {
-    hash_add(tx_enc, &vmact->node, vmact->key);
+    struct rhashtable_iter iter;
+    struct encoding_tx *vmact;
+    rhashtable_walk_enter(&tx_enc, &iter);
+    rhashtable_walk_start(&iter);
+    while ((vmact = rhashtable_walk_next(&iter)) != NULL)
+    {
+        if (IS_ERR(vmact))
+            continue;
+        fn(vmact, arg);
+    }
+    rhashtable_walk_stop(&iter);
+    rhashtable_walk_exit(&iter);
 }
 
+/**
+ * @brief      look up receiving entry, caller must hold rcu_read_lock
+ *
+ * @param[in]  table  The table
+ * @param[in]  enc    The encoding
+ *
+ * @return     entry or NULL
+ */
 struct encoding_rx* find_rx(int table, u64 enc)
 {
-    struct encoding_rx *vmacr, *ret = NULL;
-    hash_for_each_possible(rx_enc, vmacr, node, enc)
+    return rhashtable_lookup_fast(&rx_enc, &enc, rx_enc_params);
+}
+
+
+/**
+ * @brief      allocate kernel generated message (i.e. not a received frame) to
+ * userspace, in the same layout as received frames: struct control followed by data
+ * (generic netlink processes: VMAC_CMD_RX with VMAC_A_DATA)
+ *
+ * @param[in]  type  The message type
+ * @param[in]  enc   The encoding the message refers to
+ * @param[in]  len   The data length
+ * @param[in]  gfp   allocation flags
+ * @param[out] data  where the len bytes of data go
+ *
+ * @return     message to pass to vmac_nl_unicast, NULL if no process to deliver to or out of memory
+ */
+struct sk_buff* vmac_nl_new(u8 type, u64 enc, u32 len, gfp_t gfp, u8 **data)
+{
+    struct nlmsghdr *nlh;
+    struct sk_buff *skb_out;
+    struct control txc;
+    u8 genl;
+    u32 port = vmac_app_port(enc, type, &genl);
+    if (!port)
+        return NULL;
+    if (genl)
+        return vmac_genl_new(type, enc, len, gfp, port, data);
+    skb_out = nlmsg_new(len + 115, gfp);
+    if (!skb_out)
+        return NULL;
+    nlh = nlmsg_put(skb_out, 0, 0, NLMSG_DONE, len + 108, 0);
+    if (!nlh)
     {
-        ret = vmacr;
+        nlmsg_free(skb_out);
+        return NULL;
     }
-    return ret;
+    nlh->nlmsg_len = len + 100; /* userspace library strips 100 bytes of headers */
+    nlh->nlmsg_pid = port;
+    memset(&txc, 0, sizeof(struct control));
+    txc.type[0] = type;
+    memcpy(&txc.enc[0], &enc, 8);
+    memcpy(nlmsg_data(nlh), &txc, sizeof(struct control));
+    *data = nlmsg_data(nlh) + sizeof(struct control);
+    NETLINK_CB(skb_out).dst_group = 0;
+    return skb_out;
+}
+
+/**
+ * @brief      send message from vmac_nl_new to the process owning its encoding (consumes it)
+ */
+void vmac_nl_unicast(struct sk_buff *skb_out)
+{
+    if (vmac_genl_msg(skb_out))
+        vmac_genl_send(skb_out);
+    else
+        nlmsg_unicast(nl_sk, skb_out, nlmsg_hdr(skb_out)->nlmsg_pid);
 }
 
+/**
+ * @brief      send kernel generated event to userspace: to the process owning
+ * the encoding (raw or generic netlink), and to the generic netlink event group
+ * of monitoring tools
+ *
+ * @param[in]  type  The event type
+ * @param[in]  enc   The encoding the event refers to
+ * @param[in]  data  The event data
+ * @param[in]  len   The data length
+ */
+void vmac_nl_event(u8 type, u64 enc, const void *data, u16 len)
+{
+    struct sk_buff *skb_out;
+    u8 *p;
+    vmac_genl_event(type, enc, data, len);
+    skb_out = vmac_nl_new(type, enc, len, GFP_ATOMIC, &p);
+    if (!skb_out)
+        return;
+    memcpy(p, data, len);
+    vmac_nl_unicast(skb_out);
+}
 
-void exit_vmac(){
+/**
+ * @brief      Process announced its exit (type 254): drop its bindings. V-MAC
+ * keeps serving other processes until vmac_exit on module unload.
+ *
+ * @param[in]  portid  netlink port of process
+ */
+void exit_vmac(u32 portid){
 	printk(KERN_INFO "EXIT-VMAC is called!\n");
+	app_release(portid, 0);
+}
+
+/**
+ * @brief      Free all entries and the encoding tables, then the slab caches
+ * (no frame may be sent or received any more)
+ */
+static void destroy_tables(void)
+{
+    synchronize_rcu();
+    rhashtable_free_and_destroy(&rx_enc, free_rx_entry, NULL);
+    rhashtable_free_and_destroy(&tx_enc, free_tx_entry, NULL);
+    rcu_barrier(); /* entries freed by GC sweep before */
+    destroy_caches();
+}
+
+/**
+ * @brief      Tear down V-MAC on module unload (rtw_drv_halt), after the USB
+ * driver is deregistered so no frame is sent or received any more
+ *
+ * @code{.unparsed}
+ *  If V-MAC was not initialized
+ *   return
+ *  End If
+ *  mark V-MAC down, raw netlink messages are ignored from here on
+ *  unregister generic netlink family, no generic netlink message any more
+ *  unregister socket release notifier, free bindings, events have no receiver
+ *  stop GC, object, in-order delivery and completion report work
+ *  stop content store
+ *  release netlink socket, no work left that sends on it
+ *  remove procfs entries
+ *  free encoding entries, tables and caches
+ * @endcode
+ */
+void vmac_exit(void)
+{
+	if (configured != _TRUE)
+		return;
+	configured = _FALSE;
+	vmac_genl_exit();
+	app_stop();
+	vmac_gc_stop();
+	obj_stop();
+	reorder_stop();
+	txs_stop();
+	cs_stop();
 	netlink_kernel_release(nl_sk);
+	nl_sk = NULL;
+	vmac_stats_exit();
+	destroy_tables();
 }
 
 void fake_send(struct sk_buff* skb, u8 rate, u8 bw, u8 sgi, u8 stream){
@@ -223,6 +584,63 @@ void fake_send(struct sk_buff* skb, u8 rate, u8 bw, u8 sgi, u8 stream){
 }
 
 
+/**
+ * @brief      Send frame given by userspace process (raw or generic netlink)
+ *
+ * @param[in]  buf     frame payload
+ * @param[in]  len     payload length
+ * @param[in]  portid  netlink port of process, bound to encoding
+ * @param[in]  genl    port is generic netlink
+ */
+void vmac_user_tx(u64 enc, u8 type, u16 seq, const u8 *buf, u32 len, u8 rate, u8 bw, u8 sgi, u8 stream, u32 portid, u8 genl)
+{
+    struct sk_buff *skb2 = dev_alloc_skb(len + 200);
+    if (skb2 == NULL)
+    {
+        printk(KERN_INFO "VMAC_ERROR: FAILED TO ALLOCATE Memory\n");
+        return;
+    }
+    skb_reserve(skb2, 100);
+    memcpy(skb_put(skb2, len), buf, len);
+    vmac_app_bind(enc, type, portid, genl);
+    vmac_tx(skb2, enc, type, seq, rate, bw, sgi, stream, mon_adapter);
+}
+
+/**
+ * @brief      Apply VMAC_CONFIG key of userspace process (raw or generic netlink)
+ */
+void vmac_user_config(u64 enc, u8 key, u32 val, u32 portid, u8 genl)
+{
+    if (key == VMAC_CONFIG_TIMEOUT)
+        vmac_set_timeout(enc, val);
+    else if (key == VMAC_CONFIG_OBJECT)
+    {
+        vmac_app_bind(enc, VMAC_CONFIG, portid, genl);
+        vmac_set_object(enc, val);
+    }
+    else if (key == VMAC_CONFIG_ORDER)
+    {
+        vmac_app_bind(enc, VMAC_CONFIG, portid, genl);
+        vmac_set_reorder(enc, val);
+    }
+    else if (key == VMAC_CONFIG_TXSTATUS)
+    {
+        vmac_app_bind(enc, VMAC_TXDONE, portid, genl);
+        vmac_set_txstatus(enc, val);
+    }
+    else if (key == VMAC_CONFIG_DEFAULT)
+        vmac_app_default(portid, genl, val != 0);
+}
+
+/**
+ * @brief      Segment bulk publication of userspace process (raw or generic netlink)
+ */
+void vmac_user_bulk(u64 enc, const u8 *buf, u32 len, u16 mtu, const struct vmac_seg *seg, u8 rate, u8 bw, u8 sgi, u8 stream, u32 portid, u8 genl)
+{
+    vmac_app_bind(enc, VMAC_BULK, portid, genl);
+    vmac_tx_bulk(buf, len, mtu, seg, enc, rate, bw, sgi, stream, mon_adapter);
+}
+
 /**
  * @brief      Netlink Receive from userspace function
  *
@@ -232,36 +650,69 @@ void fake_send(struct sk_buff* skb, u8 rate, u8 bw, u8 sgi, u8 stream){
 static void nl_recv(struct sk_buff* skb)
 {
     struct nlmsghdr *nlh;
-    struct sk_buff* skb2;
     struct control rxc;
+    struct vmac_config cfg;
+    struct vmac_bulk bulk;
+    struct vmac_seg seg;
     u64 enc;
     u8 type;
     int size;
+    u32 portid = NETLINK_CB(skb).portid;
+    if (configured != _TRUE)
+        return;
     nlh  = (struct nlmsghdr *) skb->data;
     type = nlh->nlmsg_type;
-    if (pidt != nlh->nlmsg_pid) 
-        pidt=nlh->nlmsg_pid;
 
     if (type == VMAC_HDR_INTEREST || type == VMAC_HDR_DATA || type == VMAC_HDR_ANOUNCMENT || type == VMAC_HDR_INJECTED){
     	printk(KERN_INFO "FRAME CAME OVER HERE\n");
-        skb2 = dev_alloc_skb(nlh->nlmsg_len + 100);// -10 was here
+        if (nlh->nlmsg_len > skb->len || nlh->nlmsg_len < 100)
+            return;
         size = nlh->nlmsg_len-100;
-        memcpy(&rxc, nlmsg_data(nlh), sizeof(struct control));
-        if (skb2 == NULL)
+        if (size > VMAC_MTU_MAX + sizeof(struct vmac_seg))
         {
-            printk(KERN_INFO "VMAC_ERROR: FAILED TO ALLOCATE Memory\n");
+            /* same bound as genl_tx, before it takes a sequence and a retransmission slot */
+            vmac_stat_inc(NULL, VMAC_STAT_TX_OVERSIZE);
             return;
         }
-        skb_reserve(skb2, 100);
+        memcpy(&rxc, nlmsg_data(nlh), sizeof(struct control));
         enc = (*(uint64_t*)(rxc.enc));
-        memcpy(skb_put(skb2, size), nlmsg_data(nlh) + sizeof(struct control), size);
         printk(KERN_INFO "CALLING TX\n");
-        vmac_tx(skb2, enc, type, &rxc.seq[0], rxc.rate, rxc.bw, rxc.sgi, rxc.stream, mon_adapter);
+        vmac_user_tx(enc, type, *(u16*)(rxc.seq), nlmsg_data(nlh) + sizeof(struct control), size,
+            rxc.rate, rxc.bw, rxc.sgi, rxc.stream, portid, 0);
+    }
+    else if (type == VMAC_CONFIG){
+        if (nlmsg_len(nlh) < (int)(sizeof(struct control) + sizeof(struct vmac_config)))
+            return;
+        memcpy(&rxc, nlmsg_data(nlh), sizeof(struct control));
+        memcpy(&cfg, nlmsg_data(nlh) + sizeof(struct control), sizeof(struct vmac_config));
+        enc = (*(uint64_t*)(rxc.enc));
+        vmac_user_config(enc, cfg.key[0], *(u32*)(cfg.val), portid, 0);
+    }
+    else if (type == VMAC_BULK){
+        if (nlh->nlmsg_len > skb->len || nlmsg_len(nlh) < (int)(sizeof(struct control) + sizeof(struct vmac_bulk)))
+            return;
+        memcpy(&rxc, nlmsg_data(nlh), sizeof(struct control));
+        memcpy(&bulk, nlmsg_data(nlh) + sizeof(struct control), sizeof(struct vmac_bulk));
+        enc = (*(uint64_t*)(rxc.enc));
+        size = nlmsg_len(nlh) - sizeof(struct control) - sizeof(struct vmac_bulk);
+        if (bulk.flags[0] & VMAC_BULK_OBJECT)
+        {
+            if (size < (int)sizeof(struct vmac_seg))
+                return;
+            memcpy(&seg, nlmsg_data(nlh) + sizeof(struct control) + sizeof(struct vmac_bulk), sizeof(struct vmac_seg));
+            size -= sizeof(struct vmac_seg);
+        }
+        vmac_user_bulk(enc, nlmsg_data(nlh) + nlmsg_len(nlh) - size, size, *(u16*)(bulk.mtu), (bulk.flags[0] & VMAC_BULK_OBJECT) ? &seg : NULL,
+            rxc.rate, rxc.bw, rxc.sgi, rxc.stream, portid, 0);
     }
     else if (type == 254){
-    	exit_vmac();
+    	exit_vmac(portid);
+    }
+    else if (type == 255)
+    {
+        vmac_app_register(portid, 0);
+        printk(KERN_INFO "VMAC-upper: userspace PID Registered\n");
     }
-    else if (type == 255) printk(KERN_INFO "VMAC-upper: userspace PID Registered\n");
     else
     {
         printk(KERN_INFO "ERROR: Unknown type of frame, discarding, please contact author\n");
@@ -280,18 +731,48 @@ int vmac_init(void)
 		return 1;
 	}
     struct netlink_kernel_cfg cfg = {.input=nl_recv};    
-    pidt = -1;
+
+    if (init_tables())
+    {
+        printk(KERN_ALERT "VMAC FAILED ERROR: could not allocate encoding tables\n");
+        return -1;
+    }
+    if (cs_init())
+    {
+        printk(KERN_INFO "VMAC: content store unavailable\n");
+    }
+    if (vmac_stats_init())
+    {
+        printk(KERN_INFO "VMAC: statistics not exported to procfs\n");
+    }
+    if (app_init())
+    {
+        printk(KERN_INFO "VMAC: bindings of closed sockets are not released\n");
+    }
+    if (vmac_genl_init())
+    {
+        printk(KERN_INFO "VMAC: generic netlink family unavailable, raw netlink only\n");
+    }
     
     nl_sk = netlink_kernel_create(&init_net, VMAC_USER, &cfg);  
     if (!nl_sk)
     {
         printk(KERN_ALERT "VMAC FAILED ERROR: Please contact author\n");
-        return -1;
+        goto err_nl;
     }
 
+    vmac_gc_start();
     printk(KERN_INFO "VMAC: Installed sucessfully.\n"); 
     configured = _TRUE;
     return 0;
+
+err_nl:
+    vmac_genl_exit();
+    app_stop();
+    vmac_stats_exit();
+    cs_stop();
+    destroy_tables();
+    return -1;
 }
 #if defined(PLATFORM_LINUX) && defined (PLATFORM_WINDOWS)
 	#error "Shall be Linux or Windows, but not both!\n"
@@ -3306,6 +3787,7 @@ static struct xmit_buf *__rtw_alloc_cmd_xmitbuf(struct xmit_priv *pxmitpriv,
 	pxmitbuf = &pxmitpriv->pcmd_xmitbuf[buf_type];
 	if (pxmitbuf !=  NULL) {
 		pxmitbuf->priv_data = NULL;
+		pxmitbuf->vmac_enc = 0;
 
 #if defined(CONFIG_SDIO_HCI) || defined(CONFIG_GSPI_HCI)
 		pxmitbuf->len = 0;
@@ -3400,6 +3882,7 @@ struct xmit_buf *rtw_alloc_xmitbuf_ext(struct xmit_priv *pxmitpriv)
 
 
 		pxmitbuf->priv_data = NULL;
+		pxmitbuf->vmac_enc = 0;
 
 #if defined(CONFIG_SDIO_HCI) || defined(CONFIG_GSPI_HCI)
 		pxmitbuf->len = 0;
@@ -3486,6 +3969,7 @@ struct xmit_buf *rtw_alloc_xmitbuf(struct xmit_priv *pxmitpriv)
 		/* RTW_INFO("alloc, free_xmitbuf_cnt=%d\n", pxmitpriv->free_xmitbuf_cnt); */
 
 		pxmitbuf->priv_data = NULL;
+		pxmitbuf->vmac_enc = 0;
 
 #if defined(CONFIG_SDIO_HCI) || defined(CONFIG_GSPI_HCI)
 		pxmitbuf->len = 0;
@@ -12,10 +12,26 @@
 * 
 */
 struct sock* getsock(void);
-int getpidt(void);
 void vmac_send_hack(struct sk_buff* skb);
-void init_tables(void);
+struct sk_buff* vmac_nl_new(u8 type, u64 enc, u32 len, gfp_t gfp, u8 **data);
+void vmac_nl_unicast(struct sk_buff *skb_out);
+void vmac_nl_event(u8 type, u64 enc, const void *data, u16 len);
+struct vmac_seg;
+void vmac_user_tx(u64 enc, u8 type, u16 seq, const u8 *buf, u32 len, u8 rate, u8 bw, u8 sgi, u8 stream, u32 portid, u8 genl);
+void vmac_user_config(u64 enc, u8 key, u32 val, u32 portid, u8 genl);
+void vmac_user_bulk(u64 enc, const u8 *buf, u32 len, u16 mtu, const struct vmac_seg *seg, u8 rate, u8 bw, u8 sgi, u8 stream, u32 portid, u8 genl);
+u8* vmac_get_addr(void);
+int init_tables(void);
 struct encoding_tx* find_tx(int table, u64 enc);
 struct encoding_rx* find_rx(int table, u64 enc);
-void add_rx(struct encoding_rx*);
-void add_tx(struct encoding_tx*);
+int add_rx(struct encoding_rx*);
+int add_tx(struct encoding_tx*);
+int del_rx(struct encoding_rx*);
+int del_tx(struct encoding_tx*);
+void walk_rx(void (*fn)(struct encoding_rx*, void*), void *arg);
+void walk_tx(void (*fn)(struct encoding_tx*, void*), void *arg);
+struct encoding_rx* alloc_rx(gfp_t gfp);
+struct encoding_tx* alloc_tx(gfp_t gfp);
+void free_rx(struct encoding_rx*);
+void free_tx(struct encoding_tx*);
+struct retx_chunk* retx_chunk_get(struct encoding_tx *vmact, u16 seq, gfp_t gfp);
@@ -23,7 +23,11 @@
  * 
  * 
  * @code{.unparsed}
- *  if there is a userspace process running to receive frame
+ *  look up process owning encoding for frame type (default process if none)
+ *  if process uses generic netlink
+ *      pass frame as VMAC_CMD_RX with typed attributes and return
+ *  End If
+ *  if there is a userspace process to receive frame
  *      create memory based on size of frame and extra for control signals
  *      if memory was not created sucessfully
  *          return
@@ -38,7 +42,7 @@
  *  free memory of kernel from frame    
  * @endcode
  */
-static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
+void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
 {
     struct nlmsghdr *nlh;
     struct sk_buff* skb_out;
@@ -47,7 +51,8 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
     struct sock * nl_sk = getsock();
     uint64_t ence = (uint64_t)enc;
     uint16_t typee = (uint8_t) type;
-    int pidt = getpidt();
+    u8 genl;
+    u32 pidt = vmac_app_port(enc, type, &genl);
     char bwsg = 0;
     char offset = 0;
     u8 val;
@@ -65,12 +70,18 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
     {
         offset = 12;
     }
-    if (pidt != -1)
+    if (pidt && genl)
+    {
+        vmac_genl_rx(skb, enc, type, seq, pidt);
+        return;
+    }
+    if (pidt)
     {
         skb_out = nlmsg_new(skb->len+115,0); /* extra len for headers and buffer for firmware and driver cross communication */
         if(!skb_out) 
         {
             printk(KERN_INFO "VMAC ERROR: Failed to allocate...(i.e. contact author please)\n"); 
+            kfree_skb(skb);
             return;
         }   
         nlh = nlmsg_put(skb_out, 0, 0, NLMSG_DONE, skb->len+108, 0);
@@ -99,8 +110,188 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
         }
     }
     kfree_skb(skb);
-    nlmsg_free(skb_out);
+}
 
+/**
+ * @brief    retransmit buffered frames in [le, re) requested by a DACK
+ *
+ * @param      vmact    The tx encoding entry
+ * @param[in]  le    left edge of hole (first lost sequence)
+ * @param[in]  re    right edge of hole (exclusive)
+ * @param[in]  round    round number carried by the DACK
+ * @param[in]  seq    next sequence number to be sent for the encoding
+ * @param      counter    retransmissions done so far for this DACK
+ *
+ * @code{.unparsed}
+ *  move le up to oldest sequence still within window
+ *  while le before re && le before next sequence to send (serial comparison, see seq_before)
+ *   if chunk of le was allocated and DACK round reached retransmission pacing for le
+ *    if retransmissions for this DACK reached DACK_RETX_MAX
+ *     return //break off or kernel will crash
+ *    copy frame from retransmission buffer (under entry buffer lock, frame may be evicted)
+ *    set retransmission pacing to current DACK round + 6 (emperically)
+ *    send copy at DACK rate
+ *   End If
+ *   increment le
+ *  End While
+ * @endcode
+ */
+static void retx_range(struct encoding_tx *vmact, u16 le, u16 re, u16 round, u16 seq, int *counter)
+{
+    struct sk_buff *skb2;
+    struct retx_chunk *chunk;
+    if (seq_before(le, seq - WINDOW_TX))
+        le = seq - WINDOW_TX;
+    while(seq_before(le, re) && seq_before(le, seq))
+    {
+        chunk = retx_chunk(vmact, le);
+        if (chunk && !seq_before(round_seq(round), chunk->timer[le % RETX_CHUNK]))
+        {
+            if (*counter >= DACK_RETX_MAX)
+                return;
+            skb2 = NULL;
+            spin_lock(&vmact->buflock);
+            if (chunk->buf[le % RETX_CHUNK])
+            {
+                skb2 = skb_copy(chunk->buf[le % RETX_CHUNK], GFP_ATOMIC);
+                (*counter)++;
+            }
+            chunk->timer[le % RETX_CHUNK] = round_seq(round + 6);
+            spin_unlock(&vmact->buflock);
+            if (skb2)
+            {
+                vmac_send_hack(skb2);
+                vmac_stat_inc(vmact->stats, VMAC_STAT_RETX);
+            }
+        }
+        le++;
+    }
+}
+
+struct retx_ctx{
+    struct encoding_tx *vmact;
+    u16 round;
+    u16 seq;
+    int counter;
+    u16 lost;
+};
+
+/**
+ * @brief    dack_walk callback: retransmit one lost range and count it
+ * toward the rate adaptation loss measurement
+ *
+ * @param[in]  le    first lost sequence
+ * @param[in]  re    end of lost run (exclusive)
+ * @param      arg    struct retx_ctx
+ */
+static void retx_hole(u16 le, u16 re, void *arg)
+{
+    struct retx_ctx *ctx = (struct retx_ctx*) arg;
+    retx_range(ctx->vmact, le, re, ctx->round, ctx->seq, &ctx->counter);
+    ctx->lost += rate_overlap(le, re, ctx->round);
+}
+
+/**
+ * @brief    walk a compact DACK body and retransmit every lost range
+ *
+ * @param      vmact    The tx encoding entry
+ * @param      ddr    compact DACK header
+ * @param      body    bitmap or RLE body (ddr->len bytes, already bounds checked)
+ * @param[in]  seq    next sequence number to be sent for the encoding
+ *
+ * @return     lost sequences within the rate adaptation measurement range
+ */
+static u16 retx_compact(struct encoding_tx *vmact, struct vmac_DACK_compact *ddr, const u8 *body, u16 seq)
+{
+    struct retx_ctx ctx = {
+        .vmact = vmact,
+        .round = ddr->round,
+        .seq = seq,
+        .counter = 0,
+        .lost = 0,
+    };
+    dack_walk(ddr, body, retx_hole, &ctx);
+    return ctx.lost;
+}
+
+struct cs_ctx{
+    u64 enc;
+    int counter;
+};
+
+/**
+ * @brief    dack_walk callback: offer cached frames of a lost range (content store)
+ *
+ * @param[in]  le    first lost sequence
+ * @param[in]  re    end of lost run (exclusive)
+ * @param      arg    struct cs_ctx
+ */
+static void cs_hole(u16 le, u16 re, void *arg)
+{
+    struct cs_ctx *ctx = (struct cs_ctx*) arg;
+    cs_request(ctx->enc, le, re, &ctx->counter);
+}
+
+/**
+ * @brief    process one compact DACK (standalone or aggregated section)
+ *
+ * @param[in]  enc    encoding the DACK refers to
+ * @param      data    compact DACK header followed by its body
+ * @param[in]  len    bytes available at data
+ *
+ * @return     bytes consumed (header and body), -1 if truncated
+ *
+ * @code{.unparsed}
+ *  if header or body does not fit within len
+ *   return -1
+ *  if we are a consumer of encoding
+ *   call dack_overheard to suppress our DACK if this one covers our loss
+ *  End If
+ *  look up encoding at tx table
+ *  if entry exists
+ *   increment number of dacks received //statistics purposes
+ *   call retx_compact passing compact header and body
+ *   feed loss to rate adaptation
+ *  else
+ *   offer cached frames of every lost range from content store
+ *  End If
+ * @endcode
+ */
+static int rx_dack_compact(u64 enc, u8 *data, unsigned int len)
+{
+    struct vmac_DACK_compact *cddr = (struct vmac_DACK_compact*) data;
+    struct encoding_tx *vmact;
+    struct encoding_rx *vmacr;
+    struct cs_ctx cs;
+    u16 seq, lost;
+    if (len < sizeof(struct vmac_DACK_compact) || len - sizeof(struct vmac_DACK_compact) < cddr->len)
+        return -1;
+    vmacr = find_rx(RX_TABLE, enc);
+    if (vmacr)
+    {
+        dack_overheard(vmacr, cddr, data + sizeof(struct vmac_DACK_compact));
+    }
+    vmact = find_tx(TX_TABLE, enc);
+    if (vmact)
+    {
+        spin_lock(&vmact->seqlock);
+        seq = vmact->seq;
+        spin_unlock(&vmact->seqlock);
+        #ifdef DEBUG_MO
+            printk(KERN_INFO "Encoding of compact DACK = %lld fmt= %u len= %u", enc, cddr->fmt, cddr->len);
+        #endif
+        vmac_stat_inc(vmact->stats, VMAC_STAT_DACK_RX);
+        budget_touch(vmact);
+        lost = retx_compact(vmact, cddr, data + sizeof(struct vmac_DACK_compact), seq);
+        rate_update(vmact, cddr->round, lost);
+    }
+    else
+    {
+        cs.enc = enc;
+        cs.counter = 0;
+        dack_walk(cddr, data + sizeof(struct vmac_DACK_compact), cs_hole, &cs);
+    }
+    return sizeof(struct vmac_DACK_compact) + cddr->len;
 }
 
 /**
@@ -111,6 +302,9 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  * - 3: (used by userspace only to register, never comes to this function)
  * - 4: Announcment
  * - 5: Frame injection
+ * - 7: Compact DACK (bitmap/RLE loss state)
+ * - 8: Aggregated DACK (compact DACKs of several encodings)
+ * - 9: Object segment (data frame with object segment header)
  *
  * @param      skb    The socket buffer to be processed
  *
@@ -120,19 +314,27 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  *  pull vmac header from frame
  *  if frame type is 0
  *   set sequence value to 0 //pass to upper layer no further action
- *  else if type is 1
+ *  else if type is 1 or 9
  *   read data V-MAC header
  *   read sequence number of frame
+ *   cancel pending content store repair of frame (someone else sent it)
  *   find struct for encoding within lookup table
  *   If struct does not exist
  *    free frame
  *    return
  *   else
- *    increment timeout for encoding in LET by 30 seconds
+ *    stamp last activity of encoding in LET (idle entries freed by GC worker)
  *   End If
  *
+ *   If first frame of encoding
+ *    mark window received and set latest to sequence before stream start (0, or this frame if joining a running stream)
+ *   End If
+ *   (sequences below are compared with serial arithmetic, see seq_before)
  *   If received frame is after highest received sequence number
- *    while latest sequence number stored is less than received frame seq
+ *    If more than a window ahead
+ *     set latest to one window before frame (whole window gets cleared)
+ *    End If
+ *    while latest sequence number stored is before received frame seq
  *     increment latest sequence number
  *     indicate in sliding window frame is lost
  *    End While
@@ -141,25 +343,30 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  *    return
  *   End If
  *
- *   If frame received sequence number is within window and has not been received before
+ *   If frame received sequence number is within window of latest
  *    set sliding window index value for that frame to 1
  *   EndIf
+ *   keep copy of frame in content store (if enabled)
  *
- *   If we have NOT calculated time of first frame
- *    record time of reception
- *   else if we have NOT calculated time of second frame
- *    record time of reception
- *    calculate alpha by subtracting second frame timing from first and dividing by sequence number difference
- *    Set first frame timing to 0 //(i.e. reset)
- *      End If
- *
- *      set last index received value to received frame sequence number// note ths is a bug if frame received is retransmission
+ *   If frame is newer than last in-order frame and its arrival time is known
+ *    gap = time since last in-order frame / sequence difference (ktime, ns)
+ *    alpha = alpha - alpha/8 + gap/8 (EWMA, first sample taken as is)
+ *   End If
+ *   If frame is newer than last in-order frame (i.e. not a retransmission)
+ *    record arrival time and sequence number
+ *   End If
  *      If frame is 5th frame within round
  *       Calculate actual round number (not sequence numeber)
  *       rcall request DACK function passing encoding and round number
  *       set value for new round number
  *      End If
  *      pull Data type header from frame
+ *      If object segment
+ *       pull segment header
+ *       hand frame to object reassembly, return if it took it //object mode of encoding
+ *       else pass it up as data frame
+ *      End If
+ *      hand frame to in-order delivery, return if it took it //in-order mode of encoding
  *  else if type is 2
  *   Look up encoding at rx table
  *   look up encoding at tx table
@@ -174,21 +381,13 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  *     read hole
  *     read le
  *     read re
- *     while le <re && le < sent sequence number
- *      if DACK received round is greater than round recorder for last retx request
- *       lock tx table entry for encoding
- *       copy frame from retransmission buffer
- *       unlock tx table entry for encoding
- *       if frame is valid
- *        set retransmission pacing to current DACK round + 6 (emperically)
- *        call function retrx passing frame and 255 (i.e. data rate selected by function)
- *        vmact increment frame count (statistics purposes)
- *       End If
- *      End If
- *      increment le
- *     End While
+ *     call retx_range passing le, re and DACK round
+ *     count hole toward loss measurement
  *     pull hole from frame
  *    End While
+ *    feed loss to rate adaptation
+ *   else
+ *    for each hole offer cached frames from content store
  *   End If
  *   If entry exists at rx table
  *    if vmac rx entry succeeds at locking dacklock
@@ -205,6 +404,18 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  *   End If
  *   free frame
  *   return
+ *  else if type is 7
+ *   call rx_dack_compact passing encoding and compact DACK
+ *   free frame
+ *   return
+ *  else if type is 8
+ *   read section count
+ *   for each section
+ *    read encoding of section
+ *    call rx_dack_compact passing section encoding and compact DACK
+ *    stop if section is truncated, otherwise pull section from frame
+ *   free frame
+ *   return
  *  else if type is 4
  *   set sequence to 0 //no further action here
  *  else if type is 5
@@ -216,23 +427,24 @@ static void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq)
  *  call nl_send passing frame,encoding, type of frame, and sequence number (if exists)
  * @endcode
  */
-void vmac_rx(struct sk_buff* skb)
+static void __vmac_rx(struct sk_buff* skb)
 {
     u8 type;
-    u16 seq, holes, le, re, i = 0, round;
+    u16 seq, holes, le, re, i = 0, round, lost = 0;
     u64 enc;
     struct encoding_tx *vmact;
     struct ieee80211_hdr hdr;
     struct encoding_rx *vmacr;
     struct vmac_hole *hole;
-    struct sk_buff *skb2 = NULL;
     struct vmac_DACK *ddr;
-    int maxretx = 20;
     int counter = 0;
     u8 src[ETH_ALEN] __aligned(2) = {0xfe, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe};
     u8 dest[ETH_ALEN]__aligned(2) = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
     u8 bssid[ETH_ALEN]__aligned(2) = {0xfe, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe};
     struct vmac_data *vdr;
+    struct vmac_seg *seg;
+    ktime_t now;
+    u64 gap;
     struct vmac_hdr *vmachdr = (struct vmac_hdr*)skb->data;
     type = vmachdr->type;
     enc = vmachdr->enc;
@@ -249,11 +461,13 @@ void vmac_rx(struct sk_buff* skb)
     if (type == VMAC_HDR_INTEREST)
     {
         seq = 0;
+        vmac_stat_inc(NULL, VMAC_STAT_RX_INTEREST);
     } /* Data */
-    else if (type == VMAC_HDR_DATA)
+    else if (type == VMAC_HDR_DATA || type == VMAC_HDR_DATA_SEG)
     {
         vdr = (struct vmac_data*)skb->data;
         seq = vdr->seq;
+        cs_heard(enc, seq);
         vmacr = find_rx(RX_TABLE, enc);
         if (!vmacr || vmacr == NULL)
         {
@@ -264,48 +478,76 @@ void vmac_rx(struct sk_buff* skb)
             kfree_skb(skb);
             return;
         }
-        else
+        WRITE_ONCE(vmacr->lastactive, jiffies);
+
+        if (!vmacr->lastrx)
         {
-         mod_timer(&vmacr->enc_timeout, jiffies + msecs_to_jiffies(30000)); 
+            /* frames before stream start (or before we joined) are not requested */
+            bitmap_fill(vmacr->window, WINDOW);
+            vmacr->round = seq < WINDOW ? 0 : seq;
+            vmacr->latest = vmacr->round - 1;
         }
-
-        if (vmacr->latest < vdr->seq) //uncomment once checked clear
+        if (seq_after(seq, vmacr->latest))
         {
-            while(vmacr->latest < vdr->seq)
+            if ((u16)(seq - vmacr->latest) > WINDOW)
+            {
+                vmacr->latest = seq - WINDOW;
+            }
+            while(vmacr->latest != seq)
             {
                 vmacr->latest++;
-                vmacr->window[vmacr->latest >= WINDOW ? vmacr->latest % WINDOW : vmacr->latest] = 0;
+                clear_bit(vmacr->latest % WINDOW, vmacr->window);
             }
         }
-        else if (vmacr->window[seq >= WINDOW ? seq %WINDOW : seq] == 1)// unnecessary: &&vdr->seq>=(vmacr->latest>window?vmacr->latest%RX_WINDOW:0)
+        else if (test_bit(seq % WINDOW, vmacr->window))
         {
+            vmac_stat_inc(vmacr->stats, VMAC_STAT_DUP_DROP);
             kfree_skb(skb);
             return;
         }
 
-        if (vdr->seq >= (vmacr->latest >= WINDOW ? vmacr->latest % WINDOW : 0))
+        if ((u16)(vmacr->latest - seq) < WINDOW)
         {
-            vmacr->window[(seq >= WINDOW ? vdr->seq % WINDOW : vdr->seq)] = 1;
+            set_bit(seq % WINDOW, vmacr->window);
         }
+        vmac_stat_inc(vmacr->stats, VMAC_STAT_RX_DATA);
+        cs_store(enc, seq, skb);
 
-        if (vmacr->firstFrame == 0)
+        now = ktime_get();
+        if (vmacr->lastrx && seq_after(seq, vmacr->lastin))
         {
-            vmacr->firstFrame = jiffies;
+            gap = div_u64(ktime_to_ns(ktime_sub(now, vmacr->lastrx)), (u16)(seq - vmacr->lastin));
+            if (vmacr->alpha == 0)
+                vmacr->alpha = gap;
+            else
+                vmacr->alpha = vmacr->alpha - (vmacr->alpha >> ALPHA_SHIFT) + (gap >> ALPHA_SHIFT);
         }
-        else if (vmacr->SecondFrame == 0)
+        if (!vmacr->lastrx || seq_after(seq, vmacr->lastin))
         {
-            vmacr->SecondFrame = jiffies;
-            vmacr->alpha = (((jiffies - vmacr->firstFrame) / (vdr->seq - vmacr->lastin)));
-            vmacr->firstFrame = 0;
+            vmacr->lastrx = now;
+            vmacr->lastin = seq;
         }
-        vmacr->lastin = vdr->seq;
-        if (vmacr->round <= vdr->seq - 5)
+        if (!seq_before(seq, vmacr->round + 5))
         {
-            vmacr->round = vdr->seq / 5;
-            request_DACK(enc, vmacr->round);
-            vmacr->round = vdr->seq;
+            request_DACK(enc, seq / 5);
+            vmacr->round = seq;
         } 
         skb_pull(skb, sizeof(struct vmac_data));
+        if (type == VMAC_HDR_DATA_SEG)
+        {
+            if (skb->len < sizeof(struct vmac_seg))
+            {
+                kfree_skb(skb);
+                return;
+            }
+            seg = (struct vmac_seg*)skb->data;
+            skb_pull(skb, sizeof(struct vmac_seg));
+            if (!obj_rx(vmacr, seg, skb))
+                return;
+            type = VMAC_HDR_DATA;
+        }
+        if (!reorder_rx(vmacr, skb, seq))
+            return;
         //#ifdef DEBUG_VMAC
             //printk(KERN_INFO "VMAC SEQ: %d", vdr->seq);
         //#endif
@@ -334,36 +576,28 @@ void vmac_rx(struct sk_buff* skb)
             #ifdef DEBUG_MO
                 printk(KERN_INFO "Encoding of DACK = %lld holes= %d", enc, holes);
             #endif
-            vmact->dackcounter++;
-            hole = (struct vmac_hole*) skb->data;
-            while(i < holes && holes != 0)
+            vmac_stat_inc(vmact->stats, VMAC_STAT_DACK_RX);
+            budget_touch(vmact);
+            while(i < holes && holes != 0 && skb->len >= sizeof(struct vmac_hole))
             {
                 hole = (struct vmac_hole*)skb->data;
                 le = hole->le;
                 re = hole->re;
                 i++;
-                while(le < re && le < seq)
-                {
-                    if (round >= vmact->timer[(le >= WINDOW_TX ? le % WINDOW_TX : le)] && le >= (seq < WINDOW_TX ? 0 : seq - (WINDOW_TX)))
-                    {
-                        if (maxretx <= counter)
-                            break; /* break off or kernel will crash */
-                        if (vmact->retransmission_buffer[(le > WINDOW_TX ? le % WINDOW_TX : le)])
-                        {
-                            skb2 = skb_copy(vmact->retransmission_buffer[(le >= WINDOW_TX ? le % WINDOW_TX : le)], GFP_KERNEL); //mo here
-                            counter++;
-                        }
-                        vmact->timer[le % WINDOW_TX] = round + 6;
-                        if(skb2)
-                        {
-//                            retrx(skb2, 255); mo here
-                            vmac_send_hack(skb2);                            
-                            vmact->framecount++;
-                        } 
-                    }
-                    le++;
-                }
-                skb_pull(skb, sizeof(struct vmac_hole)); //dont pull dumbass might be needed at bottom........or...convolute things, probably easier. didn't work, will just make a copy safer....(kinda lazy to do better way lol)
+                retx_range(vmact, le, re, round, seq, &counter);
+                lost += rate_overlap(le, re, round);
+                skb_pull(skb, sizeof(struct vmac_hole));
+            }
+            rate_update(vmact, round, lost);
+        }
+        else
+        {
+            while(i < holes && skb->len >= sizeof(struct vmac_hole))
+            {
+                hole = (struct vmac_hole*)skb->data;
+                cs_request(enc, hole->le, hole->re, &counter);
+                i++;
+                skb_pull(skb, sizeof(struct vmac_hole));
             }
         }
         if (vmacr && vmacr != NULL)
@@ -375,6 +609,7 @@ void vmac_rx(struct sk_buff* skb)
                     if (vmacr->dac_info.dacksheard >= 1)
                     {
                         vmacr->dac_info.send = 0;
+                        vmac_stat_inc(vmacr->stats, VMAC_STAT_DACK_SUPPRESSED);
                     }
                     else vmacr->dac_info.dacksheard++;
                 }
@@ -383,13 +618,40 @@ void vmac_rx(struct sk_buff* skb)
         }
         kfree_skb(skb);
         return;
+    } /* Compact DACK */
+    else if (type == VMAC_HDR_DACK_COMPACT)
+    {
+        rx_dack_compact(enc, skb->data, skb->len);
+        kfree_skb(skb);
+        return;
+    } /* Aggregated DACK */
+    else if (type == VMAC_HDR_DACK_AGG)
+    {
+        if (skb->len >= sizeof(struct vmac_DACK_agg))
+        {
+            i = ((struct vmac_DACK_agg*) skb->data)->count;
+            skb_pull(skb, sizeof(struct vmac_DACK_agg));
+            while (i-- > 0 && skb->len >= sizeof(struct vmac_DACK_section))
+            {
+                enc = ((struct vmac_DACK_section*) skb->data)->enc;
+                skb_pull(skb, sizeof(struct vmac_DACK_section));
+                counter = rx_dack_compact(enc, skb->data, skb->len);
+                if (counter < 0)
+                    break;
+                skb_pull(skb, counter);
+            }
+        }
+        kfree_skb(skb);
+        return;
     } /* Announcement */
     else if (type == VMAC_HDR_ANOUNCMENT)
     {
         seq = 0;
+        vmac_stat_inc(NULL, VMAC_STAT_RX_ANN);
     } /* Injected frame */
     else if (type == VMAC_HDR_INJECTED)
     {
+        vmac_stat_inc(NULL, VMAC_STAT_RX_INJ);
         vdr = (struct vmac_data*) skb->data;
         seq = vdr->seq;
         skb_pull(skb, sizeof(struct vmac_data));
@@ -402,6 +664,19 @@ void vmac_rx(struct sk_buff* skb)
     nl_send(skb, enc, type, seq);
 }
 
+/**
+ * @brief      Entry point for received V-MAC frames, encoding entries looked up
+ * while processing are only valid within RCU read section.
+ *
+ * @param      skb   The socket buffer
+ */
+void vmac_rx(struct sk_buff* skb)
+{
+    rcu_read_lock();
+    __vmac_rx(skb);
+    rcu_read_unlock();
+}
+
 /**
  * @brief      Receives frames from low-level driver kernel module and filters V-MAC frames from non V-MAC frames.
  *
@@ -414,7 +689,7 @@ void vmac_rx(struct sk_buff* skb)
  *  if received frame 802.11 header has at first two bytes value 0xfe //(we assume it is V-MAC)
  *      Remove 802.11 header
  *      read V-MAC header
- *      if frame type is interest, data, announcment, or frame injection
+ *      if frame type is interest, data, object segment, announcment, or frame injection
  *          call vmac_rx passing frame  i.e. core
  *      else if frame type is DACK
  *          add frame to management queue
@@ -451,11 +726,11 @@ void ieee80211_rx_vmac(struct ieee80211_hw *hw, struct sk_buff *skb)
         skb_pull(skb, sizeof(struct ieee80211_hdr)); 
         vmachdr = (struct vmac_hdr*)skb->data;
         type = vmachdr->type;
-        if (type == VMAC_HDR_INTEREST || type == VMAC_HDR_DATA || type == VMAC_HDR_ANOUNCMENT || type == VMAC_HDR_INJECTED)
+        if (type == VMAC_HDR_INTEREST || type == VMAC_HDR_DATA || type == VMAC_HDR_DATA_SEG || type == VMAC_HDR_ANOUNCMENT || type == VMAC_HDR_INJECTED)
         {
             vmac_rx(skb);
         }
-        else if (type == VMAC_HDR_DACK)
+        else if (type == VMAC_HDR_DACK || type == VMAC_HDR_DACK_COMPACT || type == VMAC_HDR_DACK_AGG)
         {            
             // add_mgmt(skb); mo here
         }
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+#include "vmac.h"
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <net/net_namespace.h>
+
+DEFINE_PER_CPU(struct vmac_stats, vmac_stats);
+
+const char * const vmac_stat_names[VMAC_STAT_MAX] = {
+    [VMAC_STAT_TX_INTEREST] = "tx_interest",
+    [VMAC_STAT_TX_DATA] = "tx_data",
+    [VMAC_STAT_TX_ANN] = "tx_announcement",
+    [VMAC_STAT_TX_INJ] = "tx_injected",
+    [VMAC_STAT_RX_INTEREST] = "rx_interest",
+    [VMAC_STAT_RX_DATA] = "rx_data",
+    [VMAC_STAT_RX_ANN] = "rx_announcement",
+    [VMAC_STAT_RX_INJ] = "rx_injected",
+    [VMAC_STAT_RETX] = "retx",
+    [VMAC_STAT_RETX_CS] = "retx_cache",
+    [VMAC_STAT_DACK_TX] = "dack_tx",
+    [VMAC_STAT_DACK_RX] = "dack_rx",
+    [VMAC_STAT_DACK_SUPPRESSED] = "dack_suppressed",
+    [VMAC_STAT_DUP_DROP] = "dup_drop",
+    [VMAC_STAT_ALLOC_FAIL] = "alloc_fail",
+    [VMAC_STAT_POOL_EXHAUSTED] = "pool_exhausted",
+    [VMAC_STAT_RETX_EVICTED] = "retx_evicted",
+    [VMAC_STAT_OBJ_RX] = "obj_rx",
+    [VMAC_STAT_OBJ_PARTIAL] = "obj_partial",
+    [VMAC_STAT_TX_OVERSIZE] = "tx_oversize",
+    [VMAC_STAT_ORD_GAP] = "ord_gap",
+    [VMAC_STAT_ORD_LATE] = "ord_late",
+    [VMAC_STAT_TX_FAIL] = "tx_fail",
+    [VMAC_STAT_BIND_REFUSED] = "bind_refused",
+};
+
+/**
+ * @brief      sum counter over all CPUs
+ *
+ * @param      s     per-CPU counters of encoding, NULL for global counters
+ */
+u64 vmac_stat_sum(struct vmac_stats __percpu *s, enum vmac_stat idx)
+{
+    u64 sum = 0;
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        if (s)
+            sum += per_cpu_ptr(s, cpu)->cnt[idx];
+        else
+            sum += per_cpu(vmac_stats, cpu).cnt[idx];
+    }
+    return sum;
+}
+
+#ifdef CONFIG_PROC_DEBUG
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,18,0)
+static int vmac_stat_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_get_vmac_stat, NULL);
+}
+
+static int vmac_enc_stat_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_get_vmac_enc_stat, NULL);
+}
+
+static const struct file_operations vmac_stat_fops = {
+    .owner = THIS_MODULE,
+    .open = vmac_stat_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static const struct file_operations vmac_enc_stat_fops = {
+    .owner = THIS_MODULE,
+    .open = vmac_enc_stat_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+#endif
+
+static struct proc_dir_entry *vmac_proc;
+
+/**
+ * @brief      Create /proc/net/vmac with global (stats) and per encoding (enc_stats) counters
+ *
+ * @return     0 on success
+ */
+int vmac_stats_init(void)
+{
+    struct proc_dir_entry *dir = proc_mkdir("vmac", init_net.proc_net);
+    if (!dir)
+        return -ENOMEM;
+    vmac_proc = dir;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
+    proc_create_single("stats", 0444, dir, proc_get_vmac_stat);
+    proc_create_single("enc_stats", 0444, dir, proc_get_vmac_enc_stat);
+#else
+    proc_create("stats", 0444, dir, &vmac_stat_fops);
+    proc_create("enc_stats", 0444, dir, &vmac_enc_stat_fops);
+#endif
+    return 0;
+}
+
+/**
+ * @brief      Remove /proc/net/vmac (waits for readers still in it)
+ */
+void vmac_stats_exit(void)
+{
+    if (!vmac_proc)
+        return;
+    remove_proc_subtree("vmac", init_net.proc_net);
+    vmac_proc = NULL;
+}
+#else
+int vmac_stats_init(void)
+{
+    return 0;
+}
+
+void vmac_stats_exit(void)
+{
+}
+#endif /* CONFIG_PROC_DEBUG */
@@ -0,0 +1,72 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike 
+* 4.0 International License.
+* 
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+* 
+*/
+#include <linux/percpu.h>
+
+/* V-MAC statistics counters, kept per-CPU globally and per encoding */
+enum vmac_stat {
+    VMAC_STAT_TX_INTEREST,
+    VMAC_STAT_TX_DATA,
+    VMAC_STAT_TX_ANN,
+    VMAC_STAT_TX_INJ,
+    VMAC_STAT_RX_INTEREST,
+    VMAC_STAT_RX_DATA,
+    VMAC_STAT_RX_ANN,
+    VMAC_STAT_RX_INJ,
+    VMAC_STAT_RETX,          /* retransmissions from own retransmission buffer */
+    VMAC_STAT_RETX_CS,       /* repairs sent from content store */
+    VMAC_STAT_DACK_TX,
+    VMAC_STAT_DACK_RX,
+    VMAC_STAT_DACK_SUPPRESSED,
+    VMAC_STAT_DUP_DROP,
+    VMAC_STAT_ALLOC_FAIL,
+    VMAC_STAT_POOL_EXHAUSTED, /* no xmit frame left in driver pool */
+    VMAC_STAT_RETX_EVICTED,   /* buffered frames evicted by memory budget */
+    VMAC_STAT_OBJ_RX,         /* objects delivered complete */
+    VMAC_STAT_OBJ_PARTIAL,    /* objects delivered with missing segments */
+    VMAC_STAT_TX_OVERSIZE,    /* frames dropped for exceeding driver xmit buffer */
+    VMAC_STAT_ORD_GAP,        /* frames skipped by in-order delivery */
+    VMAC_STAT_ORD_LATE,       /* frames dropped arriving after in-order delivery skipped them */
+    VMAC_STAT_TX_FAIL,        /* reported data frames the adapter did not take */
+    VMAC_STAT_BIND_REFUSED,   /* producer/consumer claims refused, role bound to another process */
+    VMAC_STAT_MAX,
+};
+
+struct vmac_stats
+{
+    u64 cnt[VMAC_STAT_MAX];
+};
+
+DECLARE_PER_CPU(struct vmac_stats, vmac_stats);
+extern const char * const vmac_stat_names[VMAC_STAT_MAX];
+
+/**
+ * @brief      add to global counter and, if given, to counter of encoding
+ *
+ * @param      s     per-CPU counters of encoding or NULL
+ */
+static inline void vmac_stat_add(struct vmac_stats __percpu *s, enum vmac_stat idx, u64 n)
+{
+    this_cpu_add(vmac_stats.cnt[idx], n);
+    if (s)
+        this_cpu_add(s->cnt[idx], n);
+}
+
+static inline void vmac_stat_inc(struct vmac_stats __percpu *s, enum vmac_stat idx)
+{
+    vmac_stat_add(s, idx, 1);
+}
+
+u64 vmac_stat_sum(struct vmac_stats __percpu *s, enum vmac_stat idx);
+int vmac_stats_init(void);
+void vmac_stats_exit(void);
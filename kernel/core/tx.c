@@ -15,7 +15,6 @@
 #include <hal_data.h>
 #include <net/cfg80211.h>
 #include "vmac.h"
-#include <linux/rhashtable.h>
 //#define DEBUG_VMAC
 struct ieee80211_tx_control ctr = {};
 
@@ -33,35 +32,46 @@ struct ieee80211_tx_control ctr = {};
  *
  * @code{.unparsed}
  *  if type of frame is interest
- *      look up tx table for the same encoding
+ *      enter RCU read section (entries are freed after a grace period)
+ *      look up rx table for the same encoding
  *      if entry does not exist
- *          allocate struct entry (virtual memory)
+ *          allocate zeroed entry from rx slab cache outside RCU read section
  *          init variables
  *          set key to encoding
- *          setup encoding timeout
- *          insert entry into LET
+ *          insert entry into LET, if another sender inserted it first free ours and look up again
  *      end If
- *      modify timeout of entry in LET 
+ *      stamp last activity of entry (idle entries are freed by GC worker)
  *      set vmac header type value to interest
  *      push header into the frame
- *  else if type is data
+ *  else if type is data (or object segment)
+ *      enter RCU read section
  *      look up tx table for the same encoding
  *      if entry does not exist
- *          vmalloc entry (virtual memory)
+ *          allocate zeroed entry from tx slab cache outside RCU read section
  *          init variables
  *          set key to encoding
- *          setup encoding timeout
- *          insert entry into LET
+ *          insert entry into LET, if another sender inserted it first free ours and look up again
+ *          otherwise add entry to retransmission budget LRU
  *      end If
- *      modify timeout of entry in LET
+ *      stamp last activity of entry
+ *      if rate is VMAC_RATE_AUTO
+ *          take rate, bw, sgi and stream from entry rate decision
+ *      End If
  *      lock sequence lock within entry
  *      increment sequence number
- *      reset retransmission pacing value for frame
  *      push vmac data header frame into frame
  *      push vmac header frame into frame
- *      lock entry transmission
- *      copy frame into retransmission buffer
- *      unlock entry transmission
+ *      get retransmission chunk for sequence number, allocating it on first use
+ *      if chunk available
+ *          set retransmission pacing of frame to its sequence (any DACK covering it may request it)
+ *          account copy of frame against retransmission memory budget
+ *          lock entry retransmission buffer
+ *          swap copy of frame into retransmission buffer
+ *          unlock entry retransmission buffer
+ *      End If
+ *      leave RCU read section
+ *      free frame replaced in retransmission buffer
+ *      evict least recently DACKed buffered frames if over budget
  *  else if type is announcment
  *      set data rate to 0 (i.e. lowest rate)
  *      push vmac header into frame
@@ -74,6 +84,7 @@ struct ieee80211_tx_control ctr = {};
  *      free kernel of frame //i.e. unkown format, cnanot process
  *      return
  *  End If
+ *  if rate is still VMAC_RATE_AUTO (i.e. not data) use lowest rate
  *  set control station to null
  *  set flags for hardware (including QOS/No ACK, etc)
  *  call enq_uqueue function passing frame, sequence number, and rate
@@ -81,15 +92,14 @@ struct ieee80211_tx_control ctr = {};
  */
 void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw, u8 sgi, u8 stream, _adapter *mon_adapter)
 {
-    struct enc_cleanup *clean;
-    struct dack_info *dac_info;
     struct encoding_rx *vmacr;
     struct encoding_tx *vmact;
     struct vmac_data ddr;
     struct vmac_hdr vmachdr;
     struct ieee80211_hdr hdr;
-    struct sk_buff *tmp1;
+    struct sk_buff *tmp1 = NULL;
     struct sk_buff *tmp2 = NULL; 
+    struct retx_chunk *chunk;
     u16 seq;
     struct ieee80211_tx_control control = {};    
     vmachdr.type = type;
@@ -106,6 +116,7 @@ void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw,
     #endif
     if (type == VMAC_HDR_INTEREST)
     {
+        rcu_read_lock();
         vmacr = find_rx(RX_TABLE, enc);
         #ifdef DEBUG_VMAC
             printk(KERN_INFO "VMACTX: TEST");
@@ -115,117 +126,124 @@ void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw,
             #ifdef DEBUG_VMAC
                 printk(KERN_INFO "VMACTX: making new entry");
             #endif
-            vmacr = vmalloc(sizeof(struct encoding_rx));
-            clean = &vmacr->clean;
-            clean->enc = enc;
-            vmacr->key = enc;
-            clean->type = CLEAN_ENC_RX;
-            dac_info = &vmacr->dac_info;
-            dac_info->dack_counter = 0;
-            dac_info->send = 0;
-            /* init */
-            
-            vmacr->alpha = 0;
-            vmacr->firstFrame = 0;
-            vmacr->SecondFrame = 0;
-            vmacr->lastin = 0;
-            vmacr->latest = 0;
-            vmacr->round = 0;
+            rcu_read_unlock();
+            vmacr = alloc_rx(GFP_KERNEL);
+            if (!vmacr)
+            {
+                vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+                kfree_skb(skb);
+                return;
+            }
             vmacr->key = enc;
-            vmacr->dacksent = 0;
-            vmacr->dac_info.send = 0;
+            vmacr->lastactive = jiffies;
+            /* init (entry comes zeroed from slab cache) */
             spin_lock_init(&vmacr->dacklok);
             vmacr->dac_info.dacklok = &vmacr->dacklok;
             vmacr->dac_info.dack_timer = &vmacr->dack_timer;
+            INIT_LIST_HEAD(&vmacr->dack_list);
+            dack_timer_init(&vmacr->dack_timer);
 	    #ifdef DEBUG_VMAC
                 printk(KERN_INFO "VMAC: about to call rx");
             #endif
-            add_rx(vmacr);
-
-            #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
-                timer_setup(&vmacr->dack_timer, __sendDACK, 0);
-                #ifdef DEBUG_VMAC
-                    printk(KERN_INFO "CALLING MOD TIMER %u\n", vmacr->key);
-                #endif
-                timer_setup(&vmacr->enc_timeout, __cleanup_rx, 0);
-            #else
-                setup_timer(&vmacr->dack_timer, __sendDACK, (unsigned long) dac_info);
-                setup_timer(&vmacr->enc_timeout, __cleanup, (unsigned long)clean);
-            #endif
-                mod_timer(&vmacr->dack_timer, jiffies);  
+            rcu_read_lock();
+            if (add_rx(vmacr))
+            {
+                /* another sender created it first (or table is full) */
+                free_rx(vmacr);
+                vmacr = find_rx(RX_TABLE, enc);
+                if (!vmacr)
+                {
+                    rcu_read_unlock();
+                    kfree_skb(skb);
+                    return;
+                }
+            }
         }
         vmachdr.type = VMAC_HDR_INTEREST;
-	#ifdef DEBUG_VMAC
-	    printk(KERN_INFO "VMAC: about to mod timer");
-	#endif
-        mod_timer(&vmacr->enc_timeout, jiffies + msecs_to_jiffies(30000)); /* FIXME: Needs to be defaulted from vmac.h or userspace */
+        WRITE_ONCE(vmacr->lastactive, jiffies);
+        vmac_stat_inc(vmacr->stats, VMAC_STAT_TX_INTEREST);
 	
+	rcu_read_unlock();
 	#ifdef DEBUG_VMAC
 	    printk(KERN_INFO "VMAC completed");
 	#endif
         memcpy(skb_push(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
     }//Data
-    else if(type == VMAC_HDR_DATA)
+    else if(type == VMAC_HDR_DATA || type == VMAC_HDR_DATA_SEG)
     {
         #ifdef DEBUG_VMAC
             printk(KERN_INFO "VMACTX: TEST2");
         #endif
+        rcu_read_lock();
         vmact = find_tx(TX_TABLE, enc);
         if (!vmact || vmact == NULL)
         {
-            vmact = vmalloc(sizeof(struct encoding_tx));
-            clean = &vmact->clean;
-            clean->enc = enc;
-            clean->type = CLEAN_ENC_TX;
-            /* init */
+            rcu_read_unlock();
+            vmact = alloc_tx(GFP_KERNEL);
+            if (!vmact)
+            {
+                vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+                kfree_skb(skb);
+                return;
+            }
+            /* init (entry comes zeroed from slab cache) */
             spin_lock_init(&vmact->seqlock);
-            vmact->framecount = 0;
-            vmact->seq = 0;
+            spin_lock_init(&vmact->buflock);
+            INIT_LIST_HEAD(&vmact->lru);
             vmact->key = enc;
-            vmact->dackcounter = 0;
-            vmact->prevround = 0;
-            vmact->prevtime = 0;
-            #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
-                timer_setup(&vmact->enc_timeout, __cleanup_tx, 0);
-            #else
-                setup_timer(&vmact->enc_timeout, __cleanup, (unsigned long) clean);
-            #endif
-            vmact->round_inc[0] = 0;
-            vmact->round_inc[1] = 0;
-            vmact->round_inc[2] = 0;
-            vmact->round_dec[0] = 0;
-            vmact->round_dec[1] = 0;
-            vmact->round_dec[2] = 0;
-            add_tx(vmact);
+            vmact->lastactive = jiffies;
+            rate_init(&vmact->decis);
+            rcu_read_lock();
+            if (add_tx(vmact))
+            {
+                free_tx(vmact);
+                vmact = find_tx(TX_TABLE, enc);
+                if (!vmact)
+                {
+                    rcu_read_unlock();
+                    kfree_skb(skb);
+                    return;
+                }
+            }
+            else
+            {
+                budget_track(vmact);
+            }
         }
-        mod_timer(&vmact->enc_timeout, jiffies + msecs_to_jiffies(30000));/* FIXME: Needs to be defaulted from vmac.h or userspace */     
-        vmachdr.type = VMAC_HDR_DATA;
-        spin_lock(&vmact->seqlock);
+        if (rate == VMAC_RATE_AUTO)
+        {
+            rate_get(vmact, &rate, &bw, &sgi, &stream);
+        }
+        WRITE_ONCE(vmact->lastactive, jiffies);
+        vmac_stat_inc(vmact->stats, VMAC_STAT_TX_DATA);
+        spin_lock_bh(&vmact->seqlock);
         ddr.seq = vmact->seq++;
-	    spin_unlock(&vmact->seqlock);
-        vmact->timer[ddr.seq % WINDOW_TX] = 0;
+	    spin_unlock_bh(&vmact->seqlock);
         memcpy(skb_push(skb, sizeof(struct vmac_data)), &ddr, sizeof(struct vmac_data));
         memcpy(skb_push(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
-        tmp1 = skb_copy(skb, GFP_KERNEL);
-        if (ddr.seq >= WINDOW_TX)
-        {  
-            #ifdef DEBUG_VMAC
-                printk(KERN_INFO "FREEING?!\n");
-            #endif 
-            tmp2 = (vmact->retransmission_buffer[ddr.seq % WINDOW_TX]);
-        }
-        #ifdef DEBUG_VMAC
-            printk(KERN_INFO "Making copy\n");
-        #endif
-        if (tmp1)
+        chunk = retx_chunk_get(vmact, ddr.seq, GFP_ATOMIC);
+        if (chunk)
         {
-            vmact->retransmission_buffer[ddr.seq % WINDOW_TX] = tmp1;
+            #ifdef DEBUG_VMAC
+                printk(KERN_INFO "Making copy\n");
+            #endif
+            tmp1 = skb_copy(skb, GFP_ATOMIC);
+            budget_charge(tmp1);
+            spin_lock_bh(&vmact->buflock);
+            chunk->timer[ddr.seq % RETX_CHUNK] = ddr.seq;
+            /* slot still holds frame from previous pass over the window */
+            tmp2 = chunk->buf[ddr.seq % RETX_CHUNK];
+            chunk->buf[ddr.seq % RETX_CHUNK] = tmp1;
+            spin_unlock_bh(&vmact->buflock);
         }
-
-        if (tmp2)
+        if (!chunk || !tmp1)
         {
-            kfree_skb(tmp2);
+            /* frame still goes out, it just cannot be retransmitted */
+            vmac_stat_inc(vmact->stats, VMAC_STAT_ALLOC_FAIL);
         }
+        rcu_read_unlock();
+        retx_free(tmp2);
+        budget_enforce();
     }
     else if (type == VMAC_HDR_ANOUNCMENT)
     {
@@ -233,12 +251,14 @@ void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw,
             printk(KERN_INFO "VMACTX: TEST3");
         #endif
         hdr.duration_id = 0;
+        vmac_stat_inc(NULL, VMAC_STAT_TX_ANN);
         memcpy(skb_push(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
     }
     else if (type == VMAC_HDR_INJECTED)
     {
         ddr.seq = seqtmp;
         vmachdr.type = VMAC_HDR_INJECTED;
+        vmac_stat_inc(NULL, VMAC_STAT_TX_INJ);
         memcpy(skb_push(skb, sizeof(struct vmac_data)), &ddr, sizeof(struct vmac_data));
         memcpy(skb_push(skb, sizeof(struct vmac_hdr)), &vmachdr, sizeof(struct vmac_hdr));
     }
@@ -247,6 +267,14 @@ void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw,
         kfree_skb(skb);
         return;
     }
+    if (rate == VMAC_RATE_AUTO)
+    {
+        /* non-data frames reach every receiver at the lowest rate */
+        rate = 0;
+        bw = 0;
+        sgi = 0;
+        stream = 0;
+    }
     control.sta = NULL;
     IEEE80211_SKB_CB(skb)->flags = 0;
     IEEE80211_SKB_CB(skb)->flags |= IEEE80211_TX_CTL_DONTFRAG;
@@ -260,6 +288,64 @@ void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw,
     vmac_low_tx(skb, seq, rate, bw, sgi, stream, mon_adapter);
 }
 
+/**
+ * @brief      Segment a bulk publication (VMAC_BULK) into data frames and send
+ * them through vmac_tx, which assigns consecutive sequence numbers.
+ *
+ * @param[in]  buf    The object (part) to publish
+ * @param[in]  len    The length
+ * @param[in]  mtu    payload per data frame, 0 for VMAC_MTU_DEFAULT
+ * @param[in]  seg    object segment header of first segment, NULL for plain data frames
+ * @param[in]  enc    The encoding
+ *
+ * @code{.unparsed}
+ *  clamp mtu to VMAC_MTU_MAX and to what fits a driver xmit buffer
+ *  for each mtu bytes of buffer (last segment may be shorter)
+ *   allocate frame with headroom for V-MAC and 802.11 headers
+ *   copy segment
+ *   if object, push segment header (next segment index) and pass to vmac_tx as object segment
+ *   else pass to vmac_tx as data frame
+ *   yield if needed (called from netlink in process context)
+ *  End For
+ * @endcode
+ */
+void vmac_tx_bulk(const u8 *buf, u32 len, u16 mtu, const struct vmac_seg *seg, u64 enc, u8 rate, u8 bw, u8 sgi, u8 stream, _adapter *mon_adapter)
+{
+    struct sk_buff *skb;
+    struct vmac_seg sh;
+    u32 off, n;
+    if (!mtu)
+        mtu = VMAC_MTU_DEFAULT;
+    if (mtu > VMAC_MTU_MAX)
+        mtu = VMAC_MTU_MAX;
+    if (mtu + VMAC_FRAME_OVERHEAD + TXDESC_OFFSET > MAX_XMITBUF_SZ) /* 2 KB xmit buffers without USB TX aggregation */
+        mtu = MAX_XMITBUF_SZ - TXDESC_OFFSET - VMAC_FRAME_OVERHEAD;
+    if (seg)
+    {
+        sh = *seg;
+        sh.mtu = mtu;
+    }
+    for (off = 0; off < len; off += n)
+    {
+        n = min_t(u32, mtu, len - off);
+        skb = dev_alloc_skb(n + 100 + sizeof(struct vmac_seg));
+        if (!skb)
+        {
+            vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+            return;
+        }
+        skb_reserve(skb, 100 + sizeof(struct vmac_seg));
+        memcpy(skb_put(skb, n), buf + off, n);
+        if (seg)
+        {
+            memcpy(skb_push(skb, sizeof(struct vmac_seg)), &sh, sizeof(struct vmac_seg));
+            sh.idx++;
+        }
+        vmac_tx(skb, enc, seg ? VMAC_HDR_DATA_SEG : VMAC_HDR_DATA, 0, rate, bw, sgi, stream, mon_adapter);
+        cond_resched();
+    }
+}
+
 /**
  * @brief    { function_description }
  *
@@ -315,6 +401,35 @@ static struct xmit_frame* monitor_alloc_mgtxmitframe(struct xmit_priv *pxmitpriv
 	}
 	return NULL;
 }
+
+/**
+ * @brief      xmit frame backed by a data xmitbuf (MAX_XMITBUF_SZ) instead of a
+ * management one (MAX_XMIT_EXTBUF_SZ), for frames above 1.5 KB (jumbo V-MAC frames)
+ */
+static struct xmit_frame* monitor_alloc_jumbo_xmitframe(struct xmit_priv *pxmitpriv) {
+	int tries;
+	int delay = 300;
+	struct xmit_frame *pmgntframe = NULL;
+	struct xmit_buf *pxmitbuf;
+
+	for(tries = 3; tries >= 0; tries--) {
+		pmgntframe = rtw_alloc_xmitframe_ext(pxmitpriv);
+		if(pmgntframe != NULL) {
+			pxmitbuf = rtw_alloc_xmitbuf(pxmitpriv);
+			if(pxmitbuf != NULL) {
+				pmgntframe->frame_tag = MGNT_FRAMETAG;
+				pmgntframe->pxmitbuf = pxmitbuf;
+				pmgntframe->buf_addr = pxmitbuf->pbuf;
+				pxmitbuf->priv_data = pmgntframe;
+				return pmgntframe;
+			}
+			rtw_free_xmitframe(pxmitpriv, pmgntframe);
+		}
+		rtw_udelay_os(delay);
+		delay += delay/2;
+	}
+	return NULL;
+}
 #endif
 s32 xmit_mo(struct sk_buff *skb, _adapter *padapter, u8 rate, u8 bw, u8 sgi, u8 stream)
 {
@@ -348,9 +463,23 @@ s32 xmit_mo(struct sk_buff *skb, _adapter *padapter, u8 rate, u8 bw, u8 sgi, u8
 	if (skb)
 		rtw_mstat_update(MSTAT_TYPE_SKB, MSTAT_ALLOC_SUCCESS, skb->truesize);
 
-	if ((pmgntframe = monitor_alloc_mgtxmitframe(pxmitpriv)) == NULL) {
+	if (skb->len + TXDESC_OFFSET > MAX_XMITBUF_SZ) {
+		vmac_stat_inc(NULL, VMAC_STAT_TX_OVERSIZE);
+		txs_drop(skb);
+		rtw_skb_free(skb);
+		return NETDEV_TX_OK;
+	}
+	if (skb->len + TXDESC_OFFSET > MAX_XMIT_EXTBUF_SZ)
+		pmgntframe = monitor_alloc_jumbo_xmitframe(pxmitpriv);
+	else
+		pmgntframe = monitor_alloc_mgtxmitframe(pxmitpriv);
+	if (pmgntframe == NULL) {
 		DBG_COUNTER(padapter->tx_logs.core_tx_err_pxmitframe);
-		return NETDEV_TX_BUSY;
+		vmac_stat_inc(NULL, VMAC_STAT_POOL_EXHAUSTED);
+		txs_drop(skb);
+		/* callers do not requeue, frame is dropped */
+		rtw_skb_free(skb);
+		return NETDEV_TX_OK;
 	}
 
 
@@ -389,10 +518,9 @@ s32 xmit_mo(struct sk_buff *skb, _adapter *padapter, u8 rate, u8 bw, u8 sgi, u8
 	pmlmeext->mgnt_seq++;
 
 	pattrib->last_txcmdsz = pattrib->pktlen;
+	txs_tag(pmgntframe->pxmitbuf, skb);
 	dump_mgntframe(padapter, pmgntframe);
 	DBG_COUNTER(padapter->tx_logs.core_tx);
-	pxmitpriv->tx_pkts++;
-	pxmitpriv->tx_bytes += skb->len;
 	pattrib->raid = RATEID_IDX_BGN_40M_1SS;
 fail:
 	rtw_skb_free(skb);
@@ -14,6 +14,8 @@
 #include <drv_types.h>
 #include <hal_data.h>
 #include <net/cfg80211.h>
+struct vmac_seg;
 void vmac_tx(struct sk_buff* skb, u64 enc, u8 type, u16 seqtmp, u8 rate, u8 bw, u8 sgi, u8 stream, _adapter *mon_adapter);
+void vmac_tx_bulk(const u8 *buf, u32 len, u16 mtu, const struct vmac_seg *seg, u64 enc, u8 rate, u8 bw, u8 sgi, u8 stream, _adapter *mon_adapter);
 void vmac_low_tx(struct sk_buff* skb, u16 seq, u8 rate, u8 bw, u8 sgi, u8 stream, _adapter *mon_adapter);
 s32 xmit_mo(struct sk_buff *skb, _adapter *padapter, u8 rate, u8 bw, u8 sgi, u8 stream);
@@ -0,0 +1,319 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+#include "vmac.h"
+/*
+ * Transmit completion reports: data frames of encodings with reports on
+ * (VMAC_CONFIG_TXSTATUS) tag the driver xmit buffer they are copied to. When
+ * the USB transfer of that buffer completes, the frame is added to the open
+ * report of its encoding, which covers a run of consecutive sequences. Reports
+ * go to the producer as VMAC_TXDONE once they hold the configured number of
+ * frames, the sequence run breaks (e.g. retransmission), or vmac_txs_ms passed.
+ * Frames are broadcast without ACK, so completion means the adapter took the
+ * frame, not that anybody received it.
+ */
+
+static unsigned int vmac_txs_ms = 10;
+module_param(vmac_txs_ms, uint, 0644);
+MODULE_PARM_DESC(vmac_txs_ms, "Time (ms) a partly filled transmit completion report waits for more frames");
+
+#define TXS_MAX 1024 /* reports held, completions beyond are not reported */
+
+struct vmac_txs
+{
+    struct list_head list; /* txs_list, oldest first */
+    u64 enc;
+    u16 first;
+    u16 count;
+    u16 batch; /* frames per report */
+    u16 failed;
+    u8 done; /* closed, deliver now */
+    unsigned long deadline; /* jiffies */
+    u64 tstamp; /* completion of last frame (ns, CLOCK_REALTIME) */
+    u64 delay_sum; /* ns */
+    u64 delay_max;
+};
+
+static LIST_HEAD(txs_list);
+static DEFINE_SPINLOCK(txs_lock); /* txs_list, taken from USB completion (any context) */
+static unsigned int txs_count;
+static bool txs_stopped; /* module unload, no report is added any more */
+
+static void txs_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(txs_work, txs_work_fn);
+
+/* open report of encoding, caller holds txs_lock */
+static struct vmac_txs* txs_find(u64 enc)
+{
+    struct vmac_txs *t;
+    list_for_each_entry(t, &txs_list, list)
+    {
+        if (t->enc == enc && !t->done)
+            return t;
+    }
+    return NULL;
+}
+
+/**
+ * @brief      run delivery work at deadline unless it already runs earlier. Caller holds txs_lock.
+ */
+static void txs_arm(unsigned long deadline)
+{
+    unsigned long delay = time_after(deadline, jiffies) ? deadline - jiffies : 0;
+    if (!delayed_work_pending(&txs_work) || time_before(deadline, txs_work.timer.expires))
+        mod_delayed_work(system_wq, &txs_work, delay);
+}
+
+/**
+ * @brief      Sequence and report size of frame handed to driver (802.11 header first)
+ *
+ * @return     true if frame is data of an encoding with completion reports on
+ */
+static bool txs_frame(const struct sk_buff *skb, u64 *enc, u16 *seq, u16 *batch)
+{
+    struct encoding_tx *vmact;
+    struct vmac_hdr vmachdr;
+    struct vmac_data ddr;
+    u32 off = sizeof(struct ieee80211_hdr);
+    if (skb->len < off + sizeof(struct vmac_hdr) + sizeof(struct vmac_data))
+        return false;
+    memcpy(&vmachdr, skb->data + off, sizeof(struct vmac_hdr));
+    if (vmachdr.type != VMAC_HDR_DATA && vmachdr.type != VMAC_HDR_DATA_SEG)
+        return false;
+    memcpy(&ddr, skb->data + off + sizeof(struct vmac_hdr), sizeof(struct vmac_data));
+    rcu_read_lock();
+    vmact = find_tx(TX_TABLE, vmachdr.enc);
+    *batch = vmact ? READ_ONCE(vmact->txs_batch) : 0;
+    rcu_read_unlock();
+    *enc = vmachdr.enc;
+    *seq = ddr.seq;
+    return *batch != 0;
+}
+
+/**
+ * @brief      Add completed (or dropped) frame to open report of its encoding
+ *
+ * @param[in]  queued  ktime_get_ns() when frame was handed to driver
+ * @param[in]  status  0 if adapter took frame
+ *
+ * @code{.unparsed}
+ *  lock report list
+ *  If open report of encoding does not end right before sequence
+ *   close it, run delivery work now
+ *  End If
+ *  If no open report
+ *   create one starting at sequence, unless TXS_MAX reports held
+ *  End If
+ *  count frame, failure, completion time and queueing delay
+ *  If report holds batch frames
+ *   close it, run delivery work now
+ *  End If
+ *  unlock report list
+ * @endcode
+ */
+static void txs_add(u64 enc, u16 seq, u16 batch, u64 queued, int status)
+{
+    struct vmac_txs *t;
+    unsigned long flags;
+    u64 delay = ktime_get_ns() - queued;
+    if (status)
+        vmac_stat_inc(NULL, VMAC_STAT_TX_FAIL);
+    spin_lock_irqsave(&txs_lock, flags);
+    if (txs_stopped)
+    {
+        spin_unlock_irqrestore(&txs_lock, flags);
+        return;
+    }
+    t = txs_find(enc);
+    if (t && (u16)(t->first + t->count) != seq)
+    {
+        t->done = 1;
+        txs_arm(jiffies);
+        t = NULL;
+    }
+    if (!t)
+    {
+        if (txs_count < TXS_MAX)
+            t = kzalloc(sizeof(struct vmac_txs), GFP_ATOMIC);
+        if (!t)
+        {
+            spin_unlock_irqrestore(&txs_lock, flags);
+            vmac_stat_inc(NULL, VMAC_STAT_ALLOC_FAIL);
+            return;
+        }
+        t->enc = enc;
+        t->first = seq;
+        t->batch = batch;
+        t->deadline = jiffies + msecs_to_jiffies(READ_ONCE(vmac_txs_ms));
+        list_add_tail(&t->list, &txs_list);
+        txs_count++;
+        txs_arm(t->deadline);
+    }
+    t->count++;
+    if (status)
+        t->failed++;
+    t->tstamp = ktime_get_real_ns();
+    t->delay_sum += delay;
+    if (delay > t->delay_max)
+        t->delay_max = delay;
+    if (t->count >= t->batch)
+    {
+        t->done = 1;
+        txs_arm(jiffies);
+    }
+    spin_unlock_irqrestore(&txs_lock, flags);
+}
+
+/**
+ * @brief      Tag xmit buffer frame was copied to (xmit_mo), so its USB
+ * completion gets reported
+ */
+void txs_tag(struct xmit_buf *pxmitbuf, const struct sk_buff *skb)
+{
+    u64 enc;
+    u16 seq, batch;
+    if (!txs_frame(skb, &enc, &seq, &batch))
+        return;
+    pxmitbuf->vmac_seq = seq;
+    pxmitbuf->vmac_batch = batch;
+    pxmitbuf->vmac_queued = ktime_get_ns();
+    pxmitbuf->vmac_enc = enc;
+}
+
+/**
+ * @brief      Report frame driver dropped before it got an xmit buffer (xmit_mo)
+ */
+void txs_drop(const struct sk_buff *skb)
+{
+    u64 enc;
+    u16 seq, batch;
+    if (txs_frame(skb, &enc, &seq, &batch))
+        txs_add(enc, seq, batch, ktime_get_ns(), -ENOBUFS);
+}
+
+/**
+ * @brief      Transfer of xmit buffer to adapter finished (USB completion, any context)
+ *
+ * @param[in]  status  URB status, 0 on success
+ */
+void vmac_tx_done(struct xmit_buf *pxmitbuf, int status)
+{
+    u64 enc = pxmitbuf->vmac_enc;
+    if (!enc)
+        return;
+    pxmitbuf->vmac_enc = 0;
+    txs_add(enc, pxmitbuf->vmac_seq, pxmitbuf->vmac_batch, pxmitbuf->vmac_queued, status);
+}
+
+/**
+ * @brief      Send report to producer of encoding (struct vmac_txdone)
+ */
+static void txs_deliver(struct vmac_txs *t)
+{
+    struct vmac_txdone r;
+    u32 avg = div_u64(t->delay_sum, t->count * NSEC_PER_USEC);
+    u32 max = div_u64(t->delay_max, NSEC_PER_USEC);
+    memcpy(&r.first[0], &t->first, 2);
+    memcpy(&r.count[0], &t->count, 2);
+    memcpy(&r.failed[0], &t->failed, 2);
+    memcpy(&r.tstamp[0], &t->tstamp, 8);
+    memcpy(&r.delay_avg[0], &avg, 4);
+    memcpy(&r.delay_max[0], &max, 4);
+    vmac_nl_event(VMAC_TXDONE, t->enc, &r, sizeof(struct vmac_txdone));
+}
+
+/**
+ * @brief      Deliver closed and expired reports, then re-arm for the earliest
+ * remaining deadline
+ *
+ * @code{.unparsed}
+ *  lock report list
+ *  for each report
+ *   If closed or past deadline
+ *    move to local list
+ *   else
+ *    track earliest deadline
+ *   End If
+ *  End For
+ *  re-arm for earliest deadline
+ *  unlock report list
+ *  deliver and free reports in local list
+ * @endcode
+ */
+static void txs_work_fn(struct work_struct *work)
+{
+    LIST_HEAD(out);
+    struct vmac_txs *t, *tmp;
+    unsigned long flags, next = 0;
+    bool more = false;
+    spin_lock_irqsave(&txs_lock, flags);
+    list_for_each_entry_safe(t, tmp, &txs_list, list)
+    {
+        if (!t->done && time_before(jiffies, t->deadline))
+        {
+            if (!more || time_before(t->deadline, next))
+                next = t->deadline;
+            more = true;
+            continue;
+        }
+        list_move_tail(&t->list, &out);
+        txs_count--;
+    }
+    if (more)
+        txs_arm(next);
+    spin_unlock_irqrestore(&txs_lock, flags);
+    list_for_each_entry_safe(t, tmp, &out, list)
+    {
+        txs_deliver(t);
+        kfree(t);
+    }
+}
+
+/**
+ * @brief      Set completion reports of encoding (VMAC_CONFIG_TXSTATUS)
+ *
+ * @param[in]  enc     The encoding
+ * @param[in]  frames  frames per report, 0 turns reports off
+ * NOTE: applies to state kernel holds, i.e. after the first data frame was sent
+ */
+void vmac_set_txstatus(u64 enc, u32 frames)
+{
+    struct encoding_tx *vmact;
+    rcu_read_lock();
+    vmact = find_tx(TX_TABLE, enc);
+    if (vmact)
+        WRITE_ONCE(vmact->txs_batch, min_t(u32, frames, U16_MAX));
+    rcu_read_unlock();
+}
+
+/**
+ * @brief      Stop delivery work and drop reports still held (module unload).
+ * Late completions are ignored from here on, so work is not armed again.
+ */
+void txs_stop(void)
+{
+    struct vmac_txs *t, *tmp;
+    unsigned long flags;
+    spin_lock_irqsave(&txs_lock, flags);
+    txs_stopped = true;
+    spin_unlock_irqrestore(&txs_lock, flags);
+    cancel_delayed_work_sync(&txs_work);
+    spin_lock_irqsave(&txs_lock, flags);
+    list_for_each_entry_safe(t, tmp, &txs_list, list)
+    {
+        list_del(&t->list);
+        kfree(t);
+    }
+    txs_count = 0;
+    spin_unlock_irqrestore(&txs_lock, flags);
+}
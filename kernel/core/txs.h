@@ -0,0 +1,22 @@
+/*
+* Copyright (c) 2017 - 2020, Mohammed Elbadry
+*
+*
+* This file is part of V-MAC (Pub/Sub data-centric Multicast MAC layer)
+*
+* V-MAC is licensed under a Creative Commons Attribution-NonCommercial-ShareAlike
+* 4.0 International License.
+*
+* You should have received a copy of the license along with this
+* work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+*
+*/
+
+struct sk_buff;
+struct xmit_buf;
+
+/* transmit completion report functions (vmac_tx_done is declared in rtw_xmit.h of the driver) */
+void txs_tag(struct xmit_buf *pxmitbuf, const struct sk_buff *skb);
+void txs_drop(const struct sk_buff *skb);
+void vmac_set_txstatus(u64 enc, u32 frames);
+void txs_stop(void);
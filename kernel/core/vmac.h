@@ -37,16 +37,29 @@
 #include <net/ieee80211_radiotap.h>
 #include <net/cfg80211.h>
 #include <linux/hashtable.h> 
+#include <linux/rhashtable.h>
+#include <linux/rcupdate.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/kthread.h>
 #include <linux/sched.h>
 #include <linux/semaphore.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include "rtw_xmit.h"
 #include "tx.h"
 #include "clean.h"
 #include "dack.h"
+#include "rate.h"
+#include "budget.h"
+#include "cs.h"
+#include "stats.h"
+#include "obj.h"
+#include "reorder.h"
+#include "txs.h"
+#include "app.h"
+#include "genl.h"
 /*const*/
 
 
@@ -63,16 +76,31 @@
 #define VMAC_HDR_ANOUNCMENT 0x03
 #define VMAC_HDR_INJECTED 0x05
 #define V_MAC_OVERHEAR 0x06
+#define VMAC_HDR_DACK_COMPACT 0x07
+#define VMAC_HDR_DACK_AGG 0x08
+#define VMAC_HDR_DATA_SEG 0x09 /* data frame carrying object segment header (struct vmac_seg) */
+#define VMAC_CONFIG 253 /* netlink only: struct control followed by struct vmac_config */
+#define VMAC_PRESSURE 252 /* netlink only (kernel to userspace): struct control followed by struct vmac_pressure */
+#define VMAC_BULK 251 /* netlink only: struct control, struct vmac_bulk, then object segmented into data frames */
+#define VMAC_OBJECT 250 /* netlink only (kernel to userspace): struct control, struct vmac_object, then object */
+#define VMAC_GAP 249 /* netlink only (kernel to userspace): struct control followed by struct vmac_gap */
+#define VMAC_TXDONE 248 /* netlink only (kernel to userspace): struct control followed by struct vmac_txdone */
+
+/* Compact DACK body formats */
+#define VMAC_DACK_FMT_BITMAP 0x00
+#define VMAC_DACK_FMT_RLE 0x01
 
 #define sizerx 450
-#define WINDOW 700
-#define WINDOW_TX 500
+#define WINDOW 1024 /* must divide 2^16 so window slots stay contiguous across sequence wrap */
+#define WINDOW_TX 512 /* must divide 2^16, see WINDOW */
+#define RETX_CHUNK 64 /* retransmission slots allocated at once, WINDOW_TX must be a multiple */
+#define RETX_CHUNKS (WINDOW_TX / RETX_CHUNK)
+#define VMAC_MPDU_MAX 11454 /* VHT MPDU limit, 802.11 header and FCS included */
+#define VMAC_FRAME_OVERHEAD (sizeof(struct ieee80211_hdr) + sizeof(struct vmac_hdr) + sizeof(struct vmac_data) + sizeof(struct vmac_seg) + 4) /* headers of object segment and FCS */
+#define VMAC_MTU_MAX (VMAC_MPDU_MAX - VMAC_FRAME_OVERHEAD) /* largest data frame payload */
+#define VMAC_MTU_DEFAULT 1024 /* segment size of bulk publication if none given */
 
 /* VMAC ENUMS */
-enum clean_type {
-    CLEAN_ENC_TX,
-    CLEAN_ENC_RX,
-};
 enum table_type{
     RX_TABLE,
     TX_TABLE,
@@ -88,7 +116,8 @@ void vmac_rx(struct sk_buff* skb);
 void insert(void);
 int sta_info_init(struct ieee80211_local *local);
 */
-void exit_vmac(void);
+void exit_vmac(u32 portid);
+void nl_send(struct sk_buff* skb, u64 enc, u8 type, u16 seq);
 /**
  * 0=interest
  * 1=data
@@ -106,10 +135,41 @@ struct vmac_DACK{
     u16 holes;  
     u16 round;
 }__packed;
+/**
+ * Object segment, follows vmac_data in VMAC_HDR_DATA_SEG frames: segment idx
+ * of object id, whose len bytes are cut into segments of mtu bytes.
+ */
+struct vmac_seg{
+    u32 id;
+    u32 len;
+    u16 mtu;
+    u16 idx;
+}__packed;
 struct vmac_hole{
     u16 le;
     u16 re;
 }__packed;
+/**
+ * Compact DACK: base is the first lost sequence, followed by len bytes of
+ * either a loss bitmap (bit i set = base + i lost) or run lengths
+ * alternating lost/received starting with a lost run (7-bit varints).
+ */
+struct vmac_DACK_compact{
+    u16 base;
+    u16 round;
+    u16 len;
+    u8 fmt;
+}__packed;
+/**
+ * Aggregated DACK: vmac_hdr (enc unused) and count sections, each a
+ * vmac_DACK_section followed by one compact DACK (header and body).
+ */
+struct vmac_DACK_agg{
+    u8 count;
+}__packed;
+struct vmac_DACK_section{
+    u64 enc;
+}__packed;
 /**
  * 
  * vmac queue 
@@ -142,18 +202,15 @@ struct dack_info
 {
     int send; 
     u16 dack_counter;
-    u8 round;
+    u16 round;
     u8 dacksheard;
+    u8 dead; /* entry left rx table, no DACK may be armed (dack_forget) */
     spinlock_t*  dacklok;
-    struct timer_list* dack_timer;
+    struct hrtimer* dack_timer;
     struct sk_buff* dack;
     
 };
 
-struct enc_cleanup{
-    u64 enc;
-    u8 type; 
-};
 struct retrx_out_info
 {
     u64 enc;
@@ -163,39 +220,48 @@ struct retrx_out_info
 
 struct rate_decision
 {
-    u8 rate_idx[3];
-    u8 rate;
+    u8 rate_idx[3]; /* rate ladder index: current, last stable, probe ceiling */
+    u8 rate; /* worst loss (percent) reported for round */
+    u16 round; /* DACK round being accumulated */
+};
+
+struct retx_chunk
+{
+    struct sk_buff *buf[RETX_CHUNK];
+    u16 timer[RETX_CHUNK]; /* no retransmission before DACK round reaching this sequence (see round_seq) */
 };
 
 struct encoding_tx
 {
     u64 key;
-    struct enc_cleanup clean;
-    struct sk_buff *retransmission_buffer[WINDOW_TX];
-    u8 timer[WINDOW_TX]; 
+    struct retx_chunk *retx[RETX_CHUNKS]; /* retransmission buffer, chunks allocated as sequence advances */
     u16 seq;
     u16 offset; 
     u64 retrxout;
     u64 prevtime;
     u16 prevround;  
-    struct timer_list enc_timeout;  
+    unsigned long lastactive; /* jiffies of last frame sent, checked by GC worker */
+    u32 timeout; /* jiffies idle before entry is freed, 0 = vmac_enc_timeout_ms */
     struct mutex mt;
-    spinlock_t seqlock;
-    u16 dackcounter;
-    u16 framecount;
-    u8 round_inc[3];
-    u8 round_dec[3];
-    struct hlist_node node;
+    spinlock_t seqlock; /* seq, decis, round_inc and round_dec */
+    struct vmac_stats __percpu *stats;
+    struct rate_decision decis; /* rate_idx[0] is also read without lock (rate_get) */
+    u8 round_inc;
+    u8 round_dec;
+    spinlock_t buflock; /* retransmission buffer slots */
+    u16 evict_seq; /* frames below were evicted by memory budget */
+    struct list_head lru; /* retransmission budget LRU, ordered by last DACK */
+    u16 txs_batch; /* frames per transmit completion report, 0 = no reports */
+    struct rhash_head node;
+    struct rcu_head rcu;
 };
 
 struct encoding_rx
 {
     u64 key;
-    struct enc_cleanup clean;    
-    u16 window[WINDOW];
-    u32 alpha;
-    u32 firstFrame;
-    u32 SecondFrame;
+    DECLARE_BITMAP(window, WINDOW); /* received frames of sliding window */
+    u64 alpha; /* EWMA of inter-frame gap (ns) */
+    ktime_t lastrx; /* arrival time of frame lastin */
     u16 lastin;
     u16 latest; 
     struct dack_info dac_info;
@@ -204,12 +270,54 @@ struct encoding_rx
     u16 dacksent;
     spinlock_t dacklok;
     struct sk_buff* DACK;
-    struct timer_list enc_timeout;
-    struct timer_list dack_timer;
-    struct hlist_node node;
+    unsigned long lastactive; /* jiffies of last interest sent or frame received, checked by GC worker */
+    u32 timeout; /* jiffies idle before entry is freed, 0 = vmac_enc_timeout_ms */
+    struct hrtimer dack_timer;
+    struct list_head dack_list; /* pending DACK list for aggregation */
+    u32 obj_deadline; /* jiffies incomplete object waits before partial delivery, 0 = object mode off */
+    u32 obj_done; /* last object delivered, later segments of it are dropped */
+    u8 obj_seen; /* obj_done is valid */
+    u32 ord_deadline; /* jiffies a hole blocks in-order delivery, 0 = in-order mode off */
+    struct vmac_ord *ord; /* in-order delivery state, under ord_lock (reorder.c) */
+    u8 ord_dead; /* entry freed, no reorder state may be created (reorder_forget) */
+    struct vmac_stats __percpu *stats;
+    struct rhash_head node;
+    struct rcu_head rcu;
 };
 
+/**
+ * @brief      Serial number comparison of 16-bit sequences (RFC 1982): a comes
+ * before b if it is less than 2^15 behind it, so comparisons stay correct when
+ * a long-running stream wraps
+ */
+static inline bool seq_before(u16 a, u16 b)
+{
+    return (s16)(a - b) < 0;
+}
 
+static inline bool seq_after(u16 a, u16 b)
+{
+    return seq_before(b, a);
+}
+
+/**
+ * @brief      Sequence closing a DACK round (round is a fifth of the sequence
+ * that triggered it), comparable with seq_before/seq_after across wrap
+ */
+static inline u16 round_seq(u16 round)
+{
+    return round * 5;
+}
+
+/**
+ * @brief      retransmission chunk holding slot of seq
+ *
+ * @return     chunk or NULL if no frame in that chunk was sent yet
+ */
+static inline struct retx_chunk* retx_chunk(struct encoding_tx *vmact, u16 seq)
+{
+    return READ_ONCE(vmact->retx[(seq % WINDOW_TX) / RETX_CHUNK]);
+}
 
 /**
  ** ABI Be careful when changing to adjust userspace information as well.
@@ -223,3 +331,59 @@ struct control{
     char sgi;
     char stream;
 };
+
+/* VMAC_CONFIG keys */
+#define VMAC_CONFIG_TIMEOUT 0x00 /* val: idle timeout (ms) of encoding, or module default if encoding is 0 */
+#define VMAC_CONFIG_OBJECT 0x01 /* val: object mode deadline (ms) of encoding, 0 = deliver frames one by one */
+#define VMAC_CONFIG_DEFAULT 0x02 /* val: nonzero claims frames of unclaimed encodings (overheard, announcements) for sending process, 0 gives them up */
+#define VMAC_CONFIG_ORDER 0x03 /* val: in-order delivery deadline (ms) of encoding, 0 = deliver in arrival order */
+#define VMAC_CONFIG_TXSTATUS 0x04 /* val: data frames per transmit completion report of encoding, 0 = no reports */
+
+struct vmac_config{
+    char key[1];
+    char val[4];
+};
+
+/* bulk publication, struct vmac_seg (of first segment) follows if flags has VMAC_BULK_OBJECT, then data; mtu 0 = VMAC_MTU_DEFAULT */
+#define VMAC_BULK_OBJECT 0x01
+
+struct vmac_bulk{
+    char mtu[2];
+    char flags[1];
+};
+
+/* object delivered in object mode, missing segments are zero filled */
+#define VMAC_OBJ_PARTIAL 0x01 /* deadline passed (or memory ran out) before all segments arrived */
+
+struct vmac_object{
+    char id[4];
+    char len[4];
+    char missing[2]; /* segments not received */
+    char flags[1];
+};
+
+/* in-order mode gave up on count frames from first */
+struct vmac_gap{
+    char first[2];
+    char count[2];
+};
+
+/*
+ * count data frames from first completed transfer to the adapter, failed of
+ * them did not; delays run from hand-off to driver to completion
+ */
+struct vmac_txdone{
+    char first[2];
+    char count[2];
+    char failed[2];
+    char tstamp[8]; /* completion of last frame (ns, CLOCK_REALTIME) */
+    char delay_avg[4]; /* us */
+    char delay_max[4]; /* us */
+};
+
+/* retransmission memory pressure, encoding in struct control is last encoding evicted from (0 if none) */
+struct vmac_pressure{
+    char used_kb[4];
+    char budget_kb[4];
+    char evicted[4]; /* frames evicted since last report */
+};
@@ -442,6 +442,8 @@ ssize_t proc_set_sta_linking_test(struct file *file, const char __user *buffer,
 
 int proc_get_rx_stat(struct seq_file *m, void *v);
 int proc_get_tx_stat(struct seq_file *m, void *v);
+int proc_get_vmac_stat(struct seq_file *m, void *v);
+int proc_get_vmac_enc_stat(struct seq_file *m, void *v);
 #ifdef CONFIG_AP_MODE
 int proc_get_all_sta_info(struct seq_file *m, void *v);
 #endif /* CONFIG_AP_MODE */
@@ -571,6 +571,12 @@ struct xmit_buf {
 
 	struct submit_ctx *sctx;
 
+	/* V-MAC transmit completion report of data frame in buffer (core/txs.c) */
+	u64 vmac_enc; /* 0 = not reported */
+	u64 vmac_queued; /* ktime_get_ns() when frame was handed to driver */
+	u16 vmac_seq;
+	u16 vmac_batch;
+
 #ifdef CONFIG_USB_HCI
 
 	/* u32 sz[8]; */
@@ -893,6 +899,8 @@ extern s32 rtw_free_xmitbuf_ext(struct xmit_priv *pxmitpriv, struct xmit_buf *px
 
 extern struct xmit_buf *rtw_alloc_xmitbuf(struct xmit_priv *pxmitpriv);
 extern s32 rtw_free_xmitbuf(struct xmit_priv *pxmitpriv, struct xmit_buf *pxmitbuf);
+void vmac_tx_done(struct xmit_buf *pxmitbuf, int status);
+void vmac_exit(void);
 
 void rtw_count_tx_stats(_adapter *padapter, struct xmit_frame *pxmitframe, int sz);
 extern void rtw_update_protection(_adapter *padapter, u8 *ie, uint ie_len);
@@ -1654,6 +1654,7 @@ static void __exit rtw_drv_halt(void)
 	usb_drv.drv_registered = _FALSE;
 
 	usb_deregister(&usb_drv.usbdrv);
+	vmac_exit();
 
 	rtw_suspend_lock_uninit();
 	rtw_ndev_notifier_unregister();
@@ -522,6 +522,7 @@ static void usb_write_port_complete(struct urb *purb, struct pt_regs *regs)
 	#endif
 
 check_completion:
+	vmac_tx_done(pxmitbuf, purb->status);
 	_enter_critical(&pxmitpriv->lock_sctx, &irqL);
 	rtw_sctx_done_err(&pxmitbuf->sctx,
 		purb->status ? RTW_SCTX_DONE_WRITE_PORT_ERR : RTW_SCTX_DONE_SUCCESS);
@@ -672,8 +673,10 @@ u32 usb_write_port(struct intf_hdl *pintfhdl, u32 addr, u32 cnt, u8 *wmem)
 
 
 exit:
-	if (ret != _SUCCESS)
+	if (ret != _SUCCESS) {
+		vmac_tx_done(pxmitbuf, -EIO);
 		rtw_free_xmitbuf(pxmitpriv, pxmitbuf);
+	}
 	return ret;
 
 }
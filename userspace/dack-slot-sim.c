@@ -0,0 +1,195 @@
+/*
+ *      dack-slot-sim.c - Simulation of DACK feedback collisions
+ *
+ *      Compares the original randomized DACK backoff (2 * alpha * (loss + rndm))
+ *      against the slotted, loss-ordered scheme used by the kernel module
+ *      (see dack_slot() and dack_overheard() in kernel/core/dack.c).
+ *
+ *      Build: gcc dack-slot-sim.c -o dack-slot-sim
+ *      Run:   ./dack-slot-sim [trials] [per-receiver loss] [burst loss]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FRAMES          100     /* frames covered by one DACK round */
+#define MAX_RX          64      /* largest receiver population simulated */
+#define LOSS_CLASSES    8       /* DACK_LOSS_CLASSES */
+#define SLOTS_PER_CLASS 8       /* DACK_SLOTS_PER_CLASS */
+#define ALPHA           1       /* legacy alpha in DACK airtimes */
+
+struct receiver
+{
+    uint8_t lost[FRAMES];
+    int nlost;
+    long start;     /* DACK start time in DACK airtimes (x2 for legacy half slots) */
+    int sent;
+    int collided;
+    int covered;    /* loss reported by own DACK or a heard one */
+};
+
+static struct receiver rx[MAX_RX];
+
+static uint32_t hash32(uint32_t a, uint32_t b)
+{
+    uint64_t x = ((uint64_t)a << 32) | b;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+static int fls16(int v)
+{
+    int r = 0;
+    while (v)
+    {
+        r++;
+        v >>= 1;
+    }
+    return r;
+}
+
+/**
+ * @brief      Draw loss pattern: independent loss plus bursts shared by all receivers
+ */
+static void draw_loss(int n, double p, double burst)
+{
+    uint8_t shared[FRAMES];
+    int i, j;
+    for (j = 0; j < FRAMES; j++)
+        shared[j] = (double)rand() / RAND_MAX < burst;
+    for (i = 0; i < n; i++)
+    {
+        rx[i].nlost = 0;
+        for (j = 0; j < FRAMES; j++)
+        {
+            rx[i].lost[j] = (shared[j] && rand() % 4) || (double)rand() / RAND_MAX < p;
+            rx[i].nlost += rx[i].lost[j];
+        }
+        rx[i].sent = rx[i].collided = rx[i].covered = 0;
+    }
+}
+
+/* a covers b if every frame b lost is also lost (requested) by a */
+static int covers(struct receiver *a, struct receiver *b)
+{
+    int j;
+    for (j = 0; j < FRAMES; j++)
+        if (b->lost[j] && !a->lost[j])
+            return 0;
+    return 1;
+}
+
+static int by_start(const void *a, const void *b)
+{
+    const struct receiver *x = *(struct receiver * const *)a;
+    const struct receiver *y = *(struct receiver * const *)b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ * @brief      Play one feedback round: receivers transmit in start order, a
+ * receiver suppresses (slotted only) if an earlier DACK it heard cleanly covers its loss
+ *
+ * @param[in]  n         receivers
+ * @param[in]  airtime   DACK airtime in time units
+ * @param[in]  suppress  enable overheard DACK suppression
+ */
+static void play(int n, long airtime, int suppress)
+{
+    struct receiver *order[MAX_RX];
+    int i, j;
+    for (i = 0; i < n; i++)
+        order[i] = &rx[i];
+    qsort(order, n, sizeof(order[0]), by_start);
+    for (i = 0; i < n; i++)
+    {
+        struct receiver *r = order[i];
+        if (suppress)
+        {
+            for (j = 0; j < i; j++)
+            {
+                struct receiver *e = order[j];
+                if (e->sent && !e->collided && e->start + airtime <= r->start && covers(e, r))
+                {
+                    r->covered = 1;
+                    break;
+                }
+            }
+            if (r->covered)
+                continue;
+        }
+        r->sent = 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (!order[i]->sent)
+            continue;
+        for (j = 0; j < n; j++)
+        {
+            if (j != i && order[j]->sent && labs(order[i]->start - order[j]->start) < airtime)
+                order[i]->collided = 1;
+        }
+        if (!order[i]->collided)
+            order[i]->covered = 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int trials = argc > 1 ? atoi(argv[1]) : 2000;
+    double p = argc > 2 ? atof(argv[2]) : 0.02;
+    double burst = argc > 3 ? atof(argv[3]) : 0.03;
+    int n, t, i, l;
+    srand(1);
+    printf("trials=%d loss=%.3f burst=%.3f\n", trials, p, burst);
+    printf("%4s | %-30s | %-30s\n", "rx", "random backoff (legacy)", "slotted + suppression");
+    printf("%4s | %9s %9s %10s | %9s %9s %10s\n", "", "sent", "collide%", "uncovered%", "sent", "collide%", "uncovered%");
+    for (n = 1; n <= MAX_RX; n *= 2)
+    {
+        double sent[2] = {0}, coll[2] = {0}, unc[2] = {0};
+        for (t = 0; t < trials; t++)
+        {
+            draw_loss(n, p, burst);
+            /* legacy: 2 * alpha * (loss + rndm) with loss = 5 - loss when loss <= 5, 1/2 airtime units */
+            for (i = 0; i < n; i++)
+            {
+                l = rx[i].nlost <= 5 ? 5 - rx[i].nlost : rx[i].nlost;
+                rx[i].start = 2 * 2 * ALPHA * (l + rand() % 2);
+            }
+            play(n, 2, 0);
+            for (i = 0; i < n; i++)
+            {
+                sent[0] += rx[i].sent;
+                coll[0] += rx[i].collided;
+                unc[0] += !rx[i].covered;
+            }
+            /* slotted: most loss first, hashed sub slot within loss class */
+            draw_loss(n, p, burst);
+            for (i = 0; i < n; i++)
+            {
+                uint32_t addr = (uint32_t)rand();
+                int class = fls16(rx[i].nlost);
+                if (class > LOSS_CLASSES - 1)
+                    class = LOSS_CLASSES - 1;
+                rx[i].start = (LOSS_CLASSES - 1 - class) * SLOTS_PER_CLASS + hash32(addr, t) % SLOTS_PER_CLASS;
+            }
+            play(n, 1, 1);
+            for (i = 0; i < n; i++)
+            {
+                sent[1] += rx[i].sent;
+                coll[1] += rx[i].collided;
+                unc[1] += !rx[i].covered;
+            }
+        }
+        printf("%4d | %9.2f %8.2f%% %9.2f%% | %9.2f %8.2f%% %9.2f%%\n", n,
+            sent[0] / trials, sent[0] ? 100.0 * coll[0] / sent[0] : 0.0, 100.0 * unc[0] / (trials * n),
+            sent[1] / trials, sent[1] ? 100.0 * coll[1] / sent[1] : 0.0, 100.0 * unc[1] / (trials * n));
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
  *      
  */
 
+#define _GNU_SOURCE /* pthread_setaffinity_np */
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +36,24 @@
  *  ./a.out -c  --> c signfies this is the receiver/consumer
  */
 
+/**
+ * DOC : Frame size benchmark
+ * Measures goodput against data frame size, up to jumbo frames (VMAC_MTU_MAX).
+ * Start the receiver first, then the sender:
+ *
+ *  ./a.out g  --> receiver, prints goodput and loss per frame size
+ *  ./a.out s  --> sender, sends BENCH_FRAMES frames of each size in bench_sizes
+ *  ./a.out s p --> same, paced at the PHY rate (vmac_pub_pace) instead of back to back
+ */
+
+/**
+ * DOC : Multi-threaded send benchmark
+ * Measures how fast several producer threads hand frames to V-MAC in parallel,
+ * each publishing its own name ("mt0", "mt1", ...) from its own core:
+ *
+ *  ./a.out m 4  --> 4 threads send MT_FRAMES data frames each, prints frames/s
+ */
+
 /**
  * DOC : Warning
  * In a standard test run, always run the sender BEFORE
@@ -56,6 +75,7 @@ volatile int running2=0;
 volatile int total;
 volatile int consumer=0;
 volatile int producer=0;
+volatile int bench_mode=0;
 int times=0;
 FILE *sptr,*cptr,*fptr;
 double loss=0.0;
@@ -71,6 +91,25 @@ int newret = 0;
 
 FILE *logFile;
 
+#define BENCH_FRAMES 2000
+static const uint16_t bench_sizes[] = {256, 512, 1024, 1500, 2304, 4096, 8192, VMAC_MTU_MAX};
+struct bench_state
+{
+    uint16_t len; /* frame size being measured, 0 if none */
+    unsigned int frames;
+    double bytes;
+    double first, last; /* arrival of first and last frame (s) */
+} bench;
+
+#define MT_FRAMES 100000
+#define MT_THREADS_MAX 64
+struct mt_state
+{
+    pthread_t th;
+    int id;
+    double secs; /* time to send MT_FRAMES frames */
+} mt[MT_THREADS_MAX];
+
 double getRate(	uint8_t rix,uint8_t bw, uint8_t sgi, uint8_t stream);
 /**
  * vmac_send_interest  - Sends interest packet
@@ -181,6 +220,111 @@ void *vmac_send_data(void* tid)
     running2 = 0;
 }
 
+/**
+ *  vmac_send_sizes - frame size benchmark sender
+ *
+ *  Sends BENCH_FRAMES data frames of each size in bench_sizes back to back
+ *  at a fixed rate, pausing between sizes so the receiver can report.
+ *  tid non-NULL: frames are paced at the PHY rate.
+ */
+void *vmac_send_sizes(void* tid)
+{
+    char* dataname="chat";
+    static char msgy[VMAC_MTU_MAX];
+    struct vmac_frame frame;
+    struct meta_data meta;
+    struct vmac_pub *pub = NULL;
+    struct timespec t0, t1;
+    double secs;
+    int i, k;
+    memset(msgy, 'a', sizeof(msgy));
+    memset(&meta, 0, sizeof(meta));
+    meta.type = VMAC_FC_DATA;
+    meta.rate = 7;
+    meta.bw = 1;
+    meta.sgi = 1;
+    meta.stream = 1;
+    frame.buf = msgy;
+    frame.InterestName = dataname;
+    frame.name_len = 4;
+    if (tid != NULL)
+    {
+        pub = vmac_pub_open(dataname, 4, &meta);
+        vmac_pub_pace(pub, VMAC_PACE_PHY);
+    }
+    for (k = 0; k < (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0])); k++)
+    {
+        frame.len = bench_sizes[k];
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < BENCH_FRAMES; i++)
+        {
+            meta.seq = i;
+            if (pub != NULL)
+                vmac_pub_send_seq(pub, msgy, frame.len, i);
+            else
+                send_vmac(&frame, &meta);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+        printf("sent size=%u frames=%d offered=%f Mbps\n", frame.len, BENCH_FRAMES,
+            (double)frame.len * BENCH_FRAMES * 8 / secs / 1.0e6);
+        sleep(3);
+    }
+    if (pub != NULL)
+        vmac_pub_close(pub);
+    return NULL;
+}
+
+/**
+ *  vmac_send_mt - multi-threaded send benchmark thread
+ *
+ *  Sends MT_FRAMES 1024 byte data frames under its own name through a
+ *  publication handle, no pacing.
+ */
+void *vmac_send_mt(void* arg)
+{
+    struct mt_state *st = arg;
+    char name[16];
+    char msgy[1024];
+    struct vmac_pub *pub;
+    struct meta_data meta;
+    struct timespec t0, t1;
+    cpu_set_t set;
+    int i;
+    CPU_ZERO(&set);
+    CPU_SET(st->id % sysconf(_SC_NPROCESSORS_ONLN), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    memset(msgy, 'a', sizeof(msgy));
+    memset(&meta, 0, sizeof(meta));
+    snprintf(name, sizeof(name), "mt%d", st->id);
+    meta.type = VMAC_FC_DATA;
+    meta.rate = VMAC_RATE_AUTO;
+    pub = vmac_pub_open(name, strlen(name), &meta);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < MT_FRAMES; i++)
+    {
+        vmac_pub_send(pub, msgy, sizeof(msgy));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    vmac_pub_close(pub);
+    st->secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.0e9;
+    return NULL;
+}
+
+/**
+ * bench_report - print goodput and loss of the frame size measured so far
+ */
+void bench_report(void)
+{
+    double secs = bench.last - bench.first;
+    if (!bench.len)
+        return;
+    printf("size=%u | frames=%u | loss=%f | goodput=%f Mbps\n", bench.len, bench.frames,
+        100.0 * (BENCH_FRAMES - (double)bench.frames) / BENCH_FRAMES,
+        secs > 0 ? bench.bytes * 8 / secs / 1.0e6 : 0.0);
+    bench.len = 0;
+}
+
 /**
  * recv_frame - VMAC recv frame function
  *
@@ -217,6 +361,22 @@ void callbacktest(struct vmac_frame *frame, struct meta_data *meta)
     //    pthread_create(&sendth, NULL, vmac_send_data, (void*)0);
         printf("type:%u and seq=%d and count=%u @%"PRIdMAX".%03ld\n", type, seq, count, (intmax_t)s, ms);
     }
+    else if (type == VMAC_FC_DATA && bench_mode)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &spec);
+        timediff = spec.tv_sec + spec.tv_nsec / 1.0e9;
+        if (len != bench.len)
+        {
+            bench_report();
+            bench.len = len;
+            bench.frames = 0;
+            bench.bytes = 0;
+            bench.first = timediff;
+        }
+        bench.frames++;
+        bench.bytes += len;
+        bench.last = timediff;
+    }
     else if (type == VMAC_FC_DATA && consumer)
     {
         total++;
@@ -237,6 +397,10 @@ void callbacktest(struct vmac_frame *frame, struct meta_data *meta)
 		newret = ret;
 		fprintf(logFile, "%%d\n",ret);
     }
+    if (bench_mode)
+    {
+        return; /* borrowed frame (vmac_register_borrowed), nothing to free */
+    }
     free(frame);
     free(meta);
 }
@@ -288,12 +452,70 @@ void run_vmac(int weare)
 int  main(int argc, char *argv[]){
     int weare=0;
     void (*ptr)()=&callbacktest;
-    vmac_register(ptr);
+    if (argc >= 2 && strcmp(argv[1], "g") == 0)
+    {
+        bench_mode = 1;
+        vmac_register_borrowed(callbacktest);
+    }
+    else
+    {
+        vmac_register(ptr);
+    }
     if(argc < 2 ) 
     { 
         return -1;
     }
 
+    if (strcmp(argv[1], "s") == 0)
+    {
+        pthread_create(&sendth, NULL, vmac_send_sizes, (argc > 2 && strcmp(argv[2], "p") == 0) ? (void*)1 : NULL);
+        pthread_join(sendth, NULL);
+        return 0;
+    }
+    if (strcmp(argv[1], "m") == 0)
+    {
+        int i, n = argc > 2 ? atoi(argv[2]) : 2;
+        double slowest = 0;
+        if (n < 1 || n > MT_THREADS_MAX)
+        {
+            n = 2;
+        }
+        for (i = 0; i < n; i++)
+        {
+            mt[i].id = i;
+            pthread_create(&mt[i].th, NULL, vmac_send_mt, &mt[i]);
+        }
+        for (i = 0; i < n; i++)
+        {
+            pthread_join(mt[i].th, NULL);
+            printf("thread %d: %f frames/s\n", i, MT_FRAMES / mt[i].secs);
+            if (mt[i].secs > slowest)
+                slowest = mt[i].secs;
+        }
+        printf("threads=%d | total=%f frames/s\n", n, n * (double)MT_FRAMES / slowest);
+        return 0;
+    }
+    if (strcmp(argv[1], "g") == 0)
+    {
+        struct vmac_frame frame;
+        struct meta_data meta;
+        struct timespec now;
+        memset(&meta, 0, sizeof(meta));
+        frame.buf = NULL;
+        frame.len = 0;
+        frame.InterestName = "chat";
+        frame.name_len = 4;
+        meta.type = VMAC_FC_INT;
+        send_vmac(&frame, &meta);
+        while (1)
+        {
+            sleep(1);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (bench.len && now.tv_sec + now.tv_nsec / 1.0e9 - bench.last > 2)
+                bench_report();
+        }
+    }
+
     if (strncmp(argv[1], "p", sizeof(argv[1])) == 0) 
     {
 		logFile = fopen("logFile", "w");
@@ -38,6 +38,360 @@ uint8_t getrix(double rate)
     return ret;
 }
 
+/**
+ * @brief      Encoding of interest name, recording name for received frames
+ * (see name_get). Thread safe, allocates only the first time a name is seen.
+ *
+ * @param[in]  name  The interest name
+ * @param[in]  len   The name length
+ *
+ * @return     64-bit encoding
+ */
+static uint64_t name_enc(const char *name, uint16_t len)
+{
+	uint64_t enc = siphash24(name, len, vmac_priv.key);
+	struct hash *s;
+	if (len == 0)
+	{
+		return enc;
+	}
+	pthread_rwlock_rdlock(&vmac_priv.names_lock);
+	HASH_FIND(hh, vmac_priv.names, &enc, sizeof(uint64_t), s);
+	pthread_rwlock_unlock(&vmac_priv.names_lock);
+	if (s != NULL)
+	{
+		return enc;
+	}
+	pthread_rwlock_wrlock(&vmac_priv.names_lock);
+	HASH_FIND(hh, vmac_priv.names, &enc, sizeof(uint64_t), s);
+	if (s == NULL && (s = malloc(sizeof(struct hash))) != NULL)
+	{
+		s->name = malloc(len);
+		if (s->name == NULL)
+		{
+			free(s);
+		}
+		else
+		{
+			memcpy(s->name, name, len);
+			s->id = enc;
+			s->name_len = len;
+			HASH_ADD(hh, vmac_priv.names, id, sizeof(uint64_t), s);
+		}
+	}
+	pthread_rwlock_unlock(&vmac_priv.names_lock);
+	return enc;
+}
+
+/**
+ * @brief      Attaches interest name of encoding to received frame, NULL if
+ * this process never used the name. Name stays valid until del_name.
+ */
+static void name_get(uint64_t enc, struct vmac_frame *frame)
+{
+	struct hash *s;
+	pthread_rwlock_rdlock(&vmac_priv.names_lock);
+	HASH_FIND(hh, vmac_priv.names, &enc, sizeof(uint64_t), s);
+	pthread_rwlock_unlock(&vmac_priv.names_lock);
+	frame->InterestName = s != NULL ? s->name : NULL;
+	frame->name_len = s != NULL ? s->name_len : 0;
+}
+
+/**
+ * @brief      Starts generic netlink message of the vmac family in nlh
+ *
+ * @param      nlh   message buffer
+ * @param[in]  cmd   VMAC_CMD_* (or CTRL_CMD_* with family GENL_ID_CTRL)
+ * @param[in]  family  family id
+ */
+static void genl_init(struct nlmsghdr *nlh, uint8_t cmd, uint16_t family)
+{
+	struct genlmsghdr *g = NLMSG_DATA(nlh);
+	memset(nlh, 0, NLMSG_HDRLEN + GENL_HDRLEN);
+	nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	nlh->nlmsg_type = family;
+	nlh->nlmsg_flags = NLM_F_REQUEST;
+	nlh->nlmsg_pid = vmac_priv.src_addr.nl_pid;
+	g->cmd = cmd;
+	g->version = VMAC_GENL_VERSION;
+}
+
+/**
+ * @brief      Appends attribute to message in nlh
+ *
+ * @param[in]  data  attribute data, NULL to append only the attribute header
+ *                   (data of len bytes then follows the message, see genl_send)
+ */
+static void genl_put(struct nlmsghdr *nlh, uint16_t type, const void *data, uint16_t len)
+{
+	struct nlattr *a = (struct nlattr*)((char*)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+	a->nla_type = type;
+	a->nla_len = NLA_HDRLEN + len;
+	if (data == NULL)
+	{
+		nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_HDRLEN;
+		return;
+	}
+	memcpy((char*)a + NLA_HDRLEN, data, len);
+	nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(a->nla_len);
+}
+
+/**
+ * @brief      Sends message in nlh followed by len bytes of data (the last
+ * attribute, started by genl_put without data), data taken from caller's buffer.
+ * Also sends raw netlink messages (len 0).
+ *
+ * @return     0 on success.
+ */
+static int genl_send(int fd, struct nlmsghdr *nlh, const void *data, size_t len)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+	nlh->nlmsg_len += len;
+	iov[0].iov_base = nlh;
+	iov[0].iov_len = nlh->nlmsg_len - len;
+	iov[1].iov_base = (void*)data;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = (void*)&vmac_priv.dest_addr;
+	msg.msg_namelen = sizeof(vmac_priv.dest_addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = len ? 2 : 1;
+	if (sendmsg(fd, &msg, 0) < 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Looks up generic netlink family of V-MAC. Its event group is left
+ * to monitoring tools, events of own encodings come unicast.
+ *
+ * @param[in]  fd    generic netlink socket
+ *
+ * @return     family id, 0 if kernel module has no generic netlink family
+ */
+static uint16_t genl_resolve(int fd)
+{
+	char buf[8192];
+	struct nlmsghdr *nlh = (struct nlmsghdr*)buf;
+	struct nlattr *a;
+	int len, rem;
+	uint16_t id = 0;
+	genl_init(nlh, CTRL_CMD_GETFAMILY, GENL_ID_CTRL);
+	genl_put(nlh, CTRL_ATTR_FAMILY_NAME, VMAC_GENL_NAME, strlen(VMAC_GENL_NAME) + 1);
+	if (genl_send(fd, nlh, NULL, 0) < 0)
+	{
+		return 0;
+	}
+	len = recv(fd, buf, sizeof(buf), 0);
+	if (len < 0 || len < (int)NLMSG_LENGTH(GENL_HDRLEN) || !NLMSG_OK(nlh, (unsigned int)len) || nlh->nlmsg_type != GENL_ID_CTRL)
+	{
+		return 0;
+	}
+	rem = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	for (a = (struct nlattr*)((char*)NLMSG_DATA(nlh) + GENL_HDRLEN); rem >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= rem;
+		rem -= NLA_ALIGN(a->nla_len), a = (struct nlattr*)((char*)a + NLA_ALIGN(a->nla_len)))
+	{
+		if ((a->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_FAMILY_ID)
+		{
+			memcpy(&id, (char*)a + NLA_HDRLEN, sizeof(uint16_t));
+		}
+	}
+	return id;
+}
+
+/**
+ * @brief      Sends VMAC_FC_CONFIG message (raw netlink) or VMAC_CMD_CONFIG (generic netlink)
+ *
+ * @param[in]  enc   The encoding, 0 if key is not per encoding
+ * @param[in]  key   VMAC_CONFIG_* key
+ * @param[in]  val   The value
+ *
+ * @return     0 on success.
+ */
+static int send_config(uint64_t enc, uint8_t key, uint32_t val)
+{
+	char hdr[VMAC_TXHDR];
+	struct nlmsghdr *nlh = (struct nlmsghdr*)hdr;
+	struct control txc;
+	struct config cfg;
+	uint8_t type = VMAC_FC_CONFIG;
+	if (vmac_priv.genl_id)
+	{
+		genl_init(nlh, VMAC_CMD_CONFIG, vmac_priv.genl_id);
+		genl_put(nlh, VMAC_A_ENC, &enc, sizeof(uint64_t));
+		genl_put(nlh, VMAC_A_CONFIG_KEY, &key, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_CONFIG_VAL, &val, sizeof(uint32_t));
+		return genl_send(vmac_priv.sock_fd, nlh, NULL, 0);
+	}
+	memset(&txc, 0, sizeof(struct control));
+	memcpy(&txc.type[0], &type, sizeof(uint8_t));
+	memcpy(&txc.enc[0], &enc, sizeof(uint64_t));
+	cfg.key[0] = key;
+	memcpy(&cfg.val[0], &val, sizeof(uint32_t));
+	memset(nlh, 0, NLMSG_HDRLEN);
+	nlh->nlmsg_type = VMAC_FC_CONFIG;
+	nlh->nlmsg_pid = vmac_priv.src_addr.nl_pid;
+	memcpy(NLMSG_DATA(nlh), &txc, sizeof(struct control));
+	memcpy(NLMSG_DATA(nlh) + sizeof(struct control), &cfg, sizeof(struct config));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct control) + sizeof(struct config));
+	return genl_send(vmac_priv.sock_fd, nlh, NULL, 0);
+}
+
+/**
+ * @brief      Parses message of kernel (raw or generic netlink) into rx
+ *
+ * @param[in]  len   bytes received
+ *
+ * @return     0 if rx holds a frame or event, -1 to skip message (e.g. netlink error)
+ */
+static int parse_rx(struct nlmsghdr *nlh, ssize_t len, struct rx_msg *rx)
+{
+	struct control rxc;
+	struct genlmsghdr *g;
+	struct nlattr *a;
+	int rem;
+	memset(rx, 0, sizeof(struct rx_msg));
+	if (len < NLMSG_HDRLEN)
+	{
+		return -1;
+	}
+	if (!vmac_priv.genl_id)
+	{
+		if (nlh->nlmsg_len < 100)
+		{
+			return -1;
+		}
+		memcpy(&rxc, NLMSG_DATA(nlh), sizeof(struct control));
+		rx->type = (uint8_t)rxc.type[0];
+		memcpy(&rx->enc, &rxc.enc[0], sizeof(uint64_t));
+		memcpy(&rx->seq, &rxc.seq[0], sizeof(uint16_t));
+		rx->data = (char*)NLMSG_DATA(nlh) + sizeof(struct control);
+		rx->len = nlh->nlmsg_len - 100;
+		return 0;
+	}
+	g = NLMSG_DATA(nlh);
+	if (nlh->nlmsg_type != vmac_priv.genl_id || nlh->nlmsg_len > (size_t)len || nlh->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)
+		|| (g->cmd != VMAC_CMD_RX && g->cmd != VMAC_CMD_EVENT))
+	{
+		return -1;
+	}
+	rem = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	for (a = (struct nlattr*)((char*)g + GENL_HDRLEN); rem >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= rem;
+		rem -= NLA_ALIGN(a->nla_len), a = (struct nlattr*)((char*)a + NLA_ALIGN(a->nla_len)))
+	{
+		char *d = (char*)a + NLA_HDRLEN;
+		switch (a->nla_type & NLA_TYPE_MASK)
+		{
+			case VMAC_A_ENC: memcpy(&rx->enc, d, sizeof(uint64_t)); break;
+			case VMAC_A_TYPE: rx->type = *(uint8_t*)d; break;
+			case VMAC_A_SEQ: memcpy(&rx->seq, d, sizeof(uint16_t)); break;
+			case VMAC_A_RATE: rx->rate = *(uint8_t*)d; break;
+			case VMAC_A_BW: rx->bw = *(uint8_t*)d; break;
+			case VMAC_A_SGI: rx->sgi = *(uint8_t*)d; break;
+			case VMAC_A_DATA:
+				rx->data = d;
+				rx->len = a->nla_len - NLA_HDRLEN;
+				break;
+			default: break; /* attributes of newer kernel modules */
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Makes sure the pool holds a receive buffer to continue with once
+ * the current one is retained, allocating one if the pool is empty
+ *
+ * @return     0 on success, -1 if out of memory
+ */
+static int rx_reserve(void)
+{
+	struct vmac_rxbuf *n;
+	pthread_mutex_lock(&vmac_priv.rx_lock);
+	n = vmac_priv.rx_free;
+	pthread_mutex_unlock(&vmac_priv.rx_lock);
+	if (n != NULL)
+	{
+		return 0;
+	}
+	n = malloc(sizeof(struct vmac_rxbuf));
+	if (n == NULL)
+	{
+		return -1;
+	}
+	n->nlh = malloc(MAX_PAYLOAD);
+	if (n->nlh == NULL)
+	{
+		free(n);
+		return -1;
+	}
+	n->size = MAX_PAYLOAD;
+	pthread_mutex_lock(&vmac_priv.rx_lock);
+	n->next = vmac_priv.rx_free;
+	vmac_priv.rx_free = n;
+	pthread_mutex_unlock(&vmac_priv.rx_lock);
+	return 0;
+}
+
+/**
+ * @brief      Hands current receive buffer to the application (retained frame)
+ * and continues with one from the pool (rx_reserve made sure there is one)
+ */
+static void rx_detach(void)
+{
+	struct vmac_rxbuf *b = vmac_priv.rxb, *n;
+	b->nlh = vmac_priv.nlh2;
+	b->size = vmac_priv.rxsize;
+	pthread_mutex_lock(&vmac_priv.rx_lock);
+	n = vmac_priv.rx_free;
+	vmac_priv.rx_free = n->next;
+	pthread_mutex_unlock(&vmac_priv.rx_lock);
+	vmac_priv.rxb = n;
+	vmac_priv.nlh2 = n->nlh;
+	vmac_priv.rxsize = n->size;
+	vmac_priv.iov2.iov_base = (void*)vmac_priv.nlh2;
+	vmac_priv.iov2.iov_len = vmac_priv.rxsize;
+}
+
+/**
+ * @brief      Keeps frame (and its meta data) passed to a borrowed callback
+ * valid after the callback returns, until vmac_release. Its buffer is not
+ * copied, the library continues receiving into a pooled one.
+ *
+ * @param      frame  frame passed to the running callback
+ *
+ * @return     0 on success, -1 if frame is not the one being delivered or no
+ * receive buffer to continue with could be allocated (frame then stays valid
+ * during the callback only).
+ * NOTE: call from the callback only
+ */
+int vmac_retain(struct vmac_frame *frame)
+{
+	if (vmac_priv.rxb == NULL || frame != &vmac_priv.rxb->frame || rx_reserve() < 0)
+	{
+		return -1;
+	}
+	vmac_priv.retained = 1;
+	return 0;
+}
+
+/**
+ * @brief      Returns retained frame to the receive buffer pool (any thread)
+ *
+ * @param      frame  frame retained with vmac_retain
+ */
+void vmac_release(struct vmac_frame *frame)
+{
+	struct vmac_rxbuf *b = (struct vmac_rxbuf*)frame; /* frame is first member */
+	pthread_mutex_lock(&vmac_priv.rx_lock);
+	b->next = vmac_priv.rx_free;
+	vmac_priv.rx_free = b;
+	pthread_mutex_unlock(&vmac_priv.rx_lock);
+}
+
 /**
  * @brief      Reception thread
  *
@@ -47,73 +401,143 @@ uint8_t getrix(double rate)
  */
 void *recvvmac(void* tid)
 {
-    uint64_t  enc;
-	uint16_t type;
-	uint16_t seq, intnamelen;
-    char *intname;
-    int send;
-	char *buffer;
-	struct control rxc;
-	struct hash *s = NULL;
-    struct vmac_frame *frame;
-    struct meta_data *meta;
-
+	struct vmac_frame *frame;
+	struct meta_data *meta;
+	struct object obj;
+	struct rx_msg rx;
+	ssize_t len;
+	void *buf;
+	(void)tid;
 	while(1)
 	{
-	   recvmsg(vmac_priv.sock_fd, &vmac_priv.msg2, 0);
+	   if (vmac_priv.obj_cb != NULL)
+	   {
+	       /* objects do not fit the frame sized buffer, peek length first */
+	       len = recv(vmac_priv.sock_fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+	       if (len > (ssize_t)vmac_priv.rxsize)
+	       {
+	           buf = realloc(vmac_priv.nlh2, len);
+	           if (buf == NULL)
+	           {
+	               /* keep current buffer, drop the message */
+	               recv(vmac_priv.sock_fd, NULL, 0, 0);
+	               continue;
+	           }
+	           vmac_priv.nlh2 = buf;
+	           vmac_priv.rxsize = len;
+	           vmac_priv.iov2.iov_base = (void*)vmac_priv.nlh2;
+	           vmac_priv.iov2.iov_len = len;
+	       }
+	   }
+	   len = recvmsg(vmac_priv.sock_fd, &vmac_priv.msg2, 0);
+	   if (parse_rx(vmac_priv.nlh2, len, &rx) < 0)
+	   {
+	       continue;
+	   }
+	   if (rx.type == VMAC_FC_OBJECT && vmac_priv.obj_cb != NULL)
+	   {
+	       if (rx.len < sizeof(struct object))
+	       {
+	           continue;
+	       }
+	       memcpy(&obj, rx.data, sizeof(struct object));
+	       (*vmac_priv.obj_cb)(rx.enc, *(uint32_t*)(obj.id), rx.data + sizeof(struct object),
+	           *(uint32_t*)(obj.len), *(uint16_t*)(obj.missing), (uint8_t)obj.flags[0]);
+	       continue;
+	   }
+	   if (vmac_priv.borrow_cb != NULL)
+	   {
+	       /* borrowed: frame points into receive buffer, nothing allocated */
+	       frame = &vmac_priv.rxb->frame;
+	       meta = &vmac_priv.rxb->meta;
+	       frame->buf = rx.data;
+	       frame->len = rx.len;
+	       name_get(rx.enc, frame);
+	       memset(meta, 0, sizeof(struct meta_data));
+	       meta->type = rx.type;
+	       meta->seq = rx.seq;
+	       meta->enc = rx.enc;
+	       meta->rate = rx.rate;
+	       meta->bw = rx.bw;
+	       meta->sgi = rx.sgi;
+	       vmac_priv.retained = 0;
+	       (*vmac_priv.borrow_cb)(frame, meta);
+	       if (vmac_priv.retained)
+	       {
+	           rx_detach();
+	       }
+	       continue;
+	   }
        
        /* allocate structs for callback function */
        frame = malloc(sizeof(struct vmac_frame));
        meta = malloc(sizeof(struct meta_data));
+       buf = malloc(rx.len);
+       if (frame == NULL || meta == NULL || (buf == NULL && rx.len != 0))
+       {
+           /* out of memory, drop frame */
+           free(frame);
+           free(meta);
+           free(buf);
+           continue;
+       }
        /* Process received frame */
-	   buffer = malloc(vmac_priv.nlh2->nlmsg_len - 100);
-	   memcpy(&rxc, NLMSG_DATA(vmac_priv.nlh2), sizeof(struct control));
-	   memcpy(&buffer[0], NLMSG_DATA(vmac_priv.nlh2) + sizeof(struct control), vmac_priv.nlh2->nlmsg_len - 100);
-	   type = (*(uint16_t*)(rxc.type));
-	   seq = (*(uint16_t*)(rxc.seq));
-	   enc = (*(uint64_t*)(rxc.enc));
-       
-       frame->buf = buffer;
-       frame->len = vmac_priv.nlh2->nlmsg_len-100;
-       frame->InterestName = intname;
-       frame->name_len = intnamelen;
-       meta->type = type;
-       meta->seq = seq;
-       meta->enc = enc;
+       frame->buf = buf;
+       memcpy(frame->buf, rx.data, rx.len);
+       frame->len = rx.len;
+       name_get(rx.enc, frame);
+       memset(meta, 0, sizeof(struct meta_data));
+       meta->type = rx.type;
+       meta->seq = rx.seq;
+       meta->enc = rx.enc;
+       meta->rate = rx.rate;
+       meta->bw = rx.bw;
+       meta->sgi = rx.sgi;
        (*vmac_priv.cb)(frame, meta);
 	}
 }
 
 /**
- * @brief      Register process with kernel module and create rx reception thread
- *
- * @param[in]  cf    callback function pointer
- *
- * @return     0 on success
+ * @brief      Opens netlink socket (generic netlink family if kernel module has
+ * it, raw netlink otherwise) and sets up library buffers
  */
-int vmac_register(void (*cf))
+static void vmac_setup(void)
 {
 	int size;
     char keys[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xa, 0xb, 0xc, 0xd, 0xe, 0xf};
-    struct sched_param params;
     memcpy(vmac_priv.key, keys, sizeof(keys));
 	vmac_priv.msgy[0] = 'a';
-	vmac_priv.cb = cf;
-	vmac_priv.sock_fd = socket(PF_NETLINK,SOCK_RAW,VMAC_USER);
 	size = strlen(vmac_priv.msgy) + 100; /* seg fault occurs if size < 100 */
 	memset(&vmac_priv.src_addr, 0, sizeof(vmac_priv.src_addr));
 	vmac_priv.src_addr.nl_family = AF_NETLINK;
 	vmac_priv.src_addr.nl_pid = getpid();
-	bind(vmac_priv.sock_fd, (struct sockaddr*) &vmac_priv.src_addr, sizeof(vmac_priv.src_addr));
 	memset(&vmac_priv.dest_addr, 0, sizeof(vmac_priv.dest_addr));
 	vmac_priv.dest_addr.nl_family = AF_NETLINK;
 	vmac_priv.dest_addr.nl_pid = 0;
 	vmac_priv.dest_addr.nl_groups = 0;
+	/* generic netlink family if kernel module has it, raw netlink otherwise */
+	vmac_priv.sock_fd = socket(PF_NETLINK,SOCK_RAW,NETLINK_GENERIC);
+	bind(vmac_priv.sock_fd, (struct sockaddr*) &vmac_priv.src_addr, sizeof(vmac_priv.src_addr));
+	vmac_priv.genl_id = vmac_priv.sock_fd < 0 ? 0 : genl_resolve(vmac_priv.sock_fd);
+	if (!vmac_priv.genl_id)
+	{
+		if (vmac_priv.sock_fd >= 0)
+		{
+			close(vmac_priv.sock_fd);
+		}
+		vmac_priv.sock_fd = socket(PF_NETLINK,SOCK_RAW,VMAC_USER);
+		bind(vmac_priv.sock_fd, (struct sockaddr*) &vmac_priv.src_addr, sizeof(vmac_priv.src_addr));
+	}
 	vmac_priv.nlh = (struct nlmsghdr*)malloc(MAX_PAYLOAD);
 	vmac_priv.nlh2 = (struct nlmsghdr*)malloc(MAX_PAYLOAD);
+	vmac_priv.rxb = malloc(sizeof(struct vmac_rxbuf));
+	pthread_mutex_init(&vmac_priv.rx_lock, NULL);
+	pthread_rwlock_init(&vmac_priv.names_lock, NULL);
 	memset(vmac_priv.nlh, 0, MAX_PAYLOAD);
 	memset(vmac_priv.nlh2, 0, MAX_PAYLOAD);
 	vmac_priv.nlh2->nlmsg_len = MAX_PAYLOAD;
+	vmac_priv.rxsize = MAX_PAYLOAD;
+	vmac_priv.obj_id = (uint32_t)time(NULL);
 	vmac_priv.nlh->nlmsg_len = size;
 	vmac_priv.nlh->nlmsg_pid = getpid();
 	vmac_priv.nlh->nlmsg_flags = 0;
@@ -130,100 +554,916 @@ int vmac_register(void (*cf))
 	vmac_priv.msg.msg_namelen = sizeof(vmac_priv.dest_addr);
 	vmac_priv.msg.msg_iov = &vmac_priv.iov;
 	vmac_priv.msg.msg_iovlen = 1;
-	params.sched_priority = sched_get_priority_max(SCHED_FIFO);
-	pthread_setschedparam(vmac_priv.thread, SCHED_FIFO, &params);
-	pthread_create(&vmac_priv.thread, NULL, recvvmac, (void*)0);
+}
+
+/**
+ * @brief      Registers process with kernel module (type 255 or VMAC_CMD_REGISTER)
+ */
+static void vmac_announce(void)
+{
+	if (vmac_priv.genl_id)
+	{
+		genl_init(vmac_priv.nlh, VMAC_CMD_REGISTER, vmac_priv.genl_id);
+		genl_send(vmac_priv.sock_fd, vmac_priv.nlh, NULL, 0);
+		return;
+	}
 	vmac_priv.nlh->nlmsg_type = 255;
 	memset(vmac_priv.msgy, 0, 1024);
 	vmac_priv.digest64 = 0;
 	memcpy(NLMSG_DATA(vmac_priv.nlh), &vmac_priv.digest64, 8);
 	memcpy(NLMSG_DATA(vmac_priv.nlh) + 8, vmac_priv.msgy, strlen(vmac_priv.msgy));
-	size = strlen(vmac_priv.msgy) + 100;
-	sendmsg(vmac_priv.sock_fd, &vmac_priv.msg, 0);  
+	sendmsg(vmac_priv.sock_fd, &vmac_priv.msg, 0);
+}
+
+/**
+ * @brief      Register process with kernel module and create rx reception thread
+ *
+ * @param[in]  cf    callback function pointer
+ *
+ * @return     0 on success
+ */
+int vmac_register(void (*cf))
+{
+    struct sched_param params;
+	vmac_priv.cb = cf;
+	vmac_setup();
+	pthread_create(&vmac_priv.thread, NULL, recvvmac, (void*)0);
+	params.sched_priority = sched_get_priority_max(SCHED_FIFO);
+	pthread_setschedparam(vmac_priv.thread, SCHED_FIFO, &params); /* needs CAP_SYS_NICE, thread keeps default policy otherwise */
+	vmac_announce();
 	return 0;
 }
 
+/**
+ * @brief      Same as vmac_register, except cb borrows frame, buffer and meta
+ * data: they are only valid during the call, the library reuses them for the
+ * next frame unless cb calls vmac_retain. cb must not free them. Receiving
+ * then needs no heap allocation or copy per frame.
+ *
+ * @param[in]  cb    callback function pointer
+ *
+ * @return     0 on success
+ */
+int vmac_register_borrowed(void (*cb)(struct vmac_frame *frame, struct meta_data *meta))
+{
+	vmac_priv.borrow_cb = cb;
+	return vmac_register(NULL);
+}
+
+/**
+ * @brief      Registers process with kernel module without a reception thread.
+ * The application polls the returned descriptor (poll, epoll, io_uring) from
+ * its own event loop and calls vmac_recv_batch when it is readable.
+ *
+ * @return     netlink socket descriptor, -1 on error.
+ */
+int vmac_open(void)
+{
+	vmac_setup();
+	if (vmac_priv.sock_fd < 0)
+	{
+		return -1;
+	}
+	vmac_announce();
+	return vmac_priv.sock_fd;
+}
+
+/**
+ * @brief      Builds netlink headers of a frame, up to the payload
+ *
+ * @param      hdr      VMAC_TXHDR bytes
+ * @param[in]  enc      The encoding
+ * @param      meta     type, seq, rate, bw, sgi and stream
+ * @param[out] seq_off  offset of sequence number in hdr
+ *
+ * @return     header length
+ */
+static size_t tx_hdr(char *hdr, uint64_t enc, struct meta_data *meta, size_t *seq_off)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr*)hdr;
+	struct control txc;
+	if (vmac_priv.genl_id)
+	{
+		genl_init(nlh, VMAC_CMD_TX, vmac_priv.genl_id);
+		genl_put(nlh, VMAC_A_ENC, &enc, sizeof(uint64_t));
+		genl_put(nlh, VMAC_A_TYPE, &meta->type, sizeof(uint8_t));
+		*seq_off = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_HDRLEN;
+		genl_put(nlh, VMAC_A_SEQ, &meta->seq, sizeof(uint16_t));
+		genl_put(nlh, VMAC_A_RATE, &meta->rate, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_BW, &meta->bw, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_SGI, &meta->sgi, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_STREAM, &meta->stream, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_DATA, NULL, 0);
+		return nlh->nlmsg_len;
+	}
+	memset(nlh, 0, NLMSG_HDRLEN);
+	nlh->nlmsg_type = (uint16_t)meta->type;
+	nlh->nlmsg_pid = vmac_priv.src_addr.nl_pid;
+	memset(&txc, 0, sizeof(struct control));
+	memcpy(&txc.type[0], &meta->type, sizeof(uint8_t));
+	memcpy(&txc.enc[0], &enc, sizeof(uint64_t));
+	memcpy(&txc.seq[0], &meta->seq, sizeof(uint16_t));
+	memcpy(&txc.rate, &meta->rate, sizeof(uint8_t));
+	memcpy(&txc.bw, &meta->bw, sizeof(uint8_t));
+	memcpy(&txc.sgi, &meta->sgi, sizeof(uint8_t));
+	memcpy(&txc.stream, &meta->stream, sizeof(uint8_t));
+	memcpy(NLMSG_DATA(nlh), &txc, sizeof(struct control));
+	*seq_off = NLMSG_HDRLEN + offsetof(struct control, seq);
+	return NLMSG_HDRLEN + sizeof(struct control);
+}
 
 /**
- * @brief      Sends a vmac frame to V-MAC kernel module.
+ * @brief      Sets payload length in headers built by tx_hdr and fills iov
+ *
+ * @param      iov   3 entries: headers, payload and (raw netlink) padding
+ *
+ * @return     number of iov entries used
+ */
+static int tx_fill(char *hdr, size_t hlen, const char *buf, uint16_t len, struct iovec *iov)
+{
+	static const char pad[100];
+	struct nlmsghdr *nlh = (struct nlmsghdr*)hdr;
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = hlen;
+	iov[1].iov_base = (void*)buf;
+	iov[1].iov_len = len;
+	if (vmac_priv.genl_id)
+	{
+		/* VMAC_A_DATA header ends hdr, payload follows */
+		((struct nlattr*)(hdr + hlen - NLA_HDRLEN))->nla_len = NLA_HDRLEN + len;
+		nlh->nlmsg_len = hlen + len;
+		return 2;
+	}
+	/* kernel expects payload length + 100, pad message to that */
+	nlh->nlmsg_len = len + 100;
+	iov[2].iov_base = (void*)pad;
+	iov[2].iov_len = 100 - hlen;
+	return 3;
+}
+
+/**
+ * @brief      Builds netlink message of one frame: headers in hdr (VMAC_TXHDR
+ * bytes), payload sent from caller's buffer.
+ *
+ * @param      iov   3 entries: headers, payload and (raw netlink) padding
+ *
+ * @return     number of iov entries used, -1 if frame is larger than VMAC_MTU_MAX.
+ */
+static int tx_msg(char *hdr, struct iovec *iov, struct vmac_frame *frame, struct meta_data *meta)
+{
+	size_t seq_off;
+	if (frame->len > VMAC_MTU_MAX)
+	{
+		return -1;
+	}
+	return tx_fill(hdr, tx_hdr(hdr, name_enc(frame->InterestName, frame->name_len), meta, &seq_off),
+		frame->buf, frame->len, iov);
+}
+
+/**
+ * @brief      sendmsg of iov entries built by tx_fill
+ */
+static int tx_send(struct iovec *iov, int n)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = (void*)&vmac_priv.dest_addr;
+	msg.msg_namelen = sizeof(vmac_priv.dest_addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+	if (sendmsg(vmac_priv.sock_fd, &msg, 0) < 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Sends a vmac frame to V-MAC kernel module. Thread safe: message
+ * is built on the caller's stack, so threads may send concurrently.
  *
  * @param[in]  frame  contains data and interest buffers with their lengths, respectively.
  * @param      meta   contains meta data to be passed to kernel (e.g., type of frame, rate, sequence if applicable)
  *
- * @return     0 on success. 
+ * @return     0 on success, -1 if frame is larger than VMAC_MTU_MAX.
  */
 int send_vmac(struct vmac_frame *frame, struct meta_data *meta)
 {
-	struct control txc;
-	struct hash *s;
-	char *name;
-	uint8_t ratesh = meta->rate;
-	vmac_priv.digest64 = siphash24(frame->InterestName, frame->name_len, vmac_priv.key);
-	vmac_priv.nlh->nlmsg_type = (uint16_t)meta->type;
+	char hdr[VMAC_TXHDR];
+	struct iovec iov[3];
+	int n = tx_msg(hdr, iov, frame, meta);
+	if (n < 0)
+	{
+		return -1;
+	}
+	tx_send(iov, n);
+	return 0;
+}
 
-    memcpy(&txc.type[0], &meta->type, sizeof(uint8_t));
-	memcpy(&txc.enc[0], &vmac_priv.digest64, sizeof(uint64_t));
-	memcpy(&txc.seq[0], &meta->seq, sizeof(uint16_t));
-	memcpy(&txc.rate, &ratesh, sizeof(uint8_t));
+/**
+ * @brief      Opens a publication: encoding and frame headers are computed once,
+ * so vmac_pub_send only adds payload and sequence number.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * @param      meta          type, rate, bw, sgi and stream of all frames, seq of the first one
+ *
+ * @return     handle to pass to vmac_pub_send and vmac_pub_close, NULL on error.
+ * NOTE: call after vmac_register or vmac_open. A handle is used by one thread at a time.
+ */
+struct vmac_pub *vmac_pub_open(char *InterestName, uint16_t name_len, struct meta_data *meta)
+{
+	struct vmac_pub *pub = malloc(sizeof(struct vmac_pub));
+	if (pub == NULL)
+	{
+		return NULL;
+	}
+	memset(pub, 0, sizeof(struct vmac_pub));
+	pub->enc = name_enc(InterestName, name_len);
+	pub->seq = meta->seq;
+	pub->rate = meta->rate;
+	pub->bw = meta->bw;
+	pub->sgi = meta->sgi;
+	pub->stream = meta->stream;
+	pub->hlen = tx_hdr(pub->hdr, pub->enc, meta, &pub->seq_off);
+	return pub;
+}
+
+static uint64_t mono_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief      Token bucket: waits until airtime of frame is available. Credit of
+ * an idle publication is capped at VMAC_PACE_BURST_NS.
+ *
+ * @param[in]  len   payload length
+ */
+static void pace(struct vmac_pub *pub, uint16_t len)
+{
+	struct timespec ts;
+	uint64_t now = mono_ns();
+	if (pub->next + VMAC_PACE_BURST_NS < now)
+	{
+		pub->next = now - VMAC_PACE_BURST_NS;
+	}
+	if (pub->next > now)
+	{
+		ts.tv_sec = pub->next / 1000000000ULL;
+		ts.tv_nsec = pub->next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+	}
+	pub->next += pub->frame_ns + (uint64_t)((len + VMAC_MPDU_MAX - VMAC_MTU_MAX) * pub->ns_per_byte);
+}
+
+/**
+ * @brief      Paces frames of a publication so producers do not overrun the
+ * radio (driver transmit frames run out and frames are dropped).
+ *
+ * @param      pub   handle of vmac_pub_open
+ * @param[in]  mbps  target bitrate (Mbps) of frames on air, VMAC_PACE_PHY for
+ *                   the rates[] entry of the handle's rate, bw, sgi and stream
+ *                   with per-frame medium access overhead, 0 turns pacing off
+ *
+ * @return     0 on success, -1 if VMAC_PACE_PHY and handle has no fixed rate in rates[].
+ */
+int vmac_pub_pace(struct vmac_pub *pub, double mbps)
+{
+	int i;
+	if (mbps == VMAC_PACE_PHY)
+	{
+		for (i = 0; i < RATES_NUM; i++)
+		{
+			if (rates[i].rix == pub->rate && rates[i].bw == pub->bw && rates[i].sgi == pub->sgi
+				&& rates[i].stream == pub->stream && rates[i].rate < 1000) /* placeholders of MCS 9 */
+			{
+				break;
+			}
+		}
+		if (i == RATES_NUM || pub->rate == VMAC_RATE_AUTO)
+		{
+			return -1;
+		}
+		pub->ns_per_byte = 8000.0 / rates[i].rate;
+		pub->frame_ns = VMAC_PACE_FRAME_NS;
+	}
+	else
+	{
+		pub->ns_per_byte = mbps > 0 ? 8000.0 / mbps : 0;
+		pub->frame_ns = 0;
+	}
+	pub->next = mono_ns();
+	return 0;
+}
+
+/**
+ * @brief      Time until a paced publication may send its next frame, for
+ * event loops that arm a timer (e.g. timerfd) instead of blocking in vmac_pub_send
+ *
+ * @return     nanoseconds, 0 if a frame can be sent now or pacing is off.
+ */
+uint64_t vmac_pub_wait_ns(struct vmac_pub *pub)
+{
+	uint64_t now = mono_ns();
+	if (pub->ns_per_byte <= 0 || pub->next <= now)
+	{
+		return 0;
+	}
+	return pub->next - now;
+}
+
+/**
+ * @brief      Sends a frame of a publication with an explicit sequence number
+ *
+ * @param      pub   handle of vmac_pub_open
+ * @param[in]  buf   The payload
+ * @param[in]  len   The payload length
+ * @param[in]  seq   The sequence number, next vmac_pub_send continues after it
+ *
+ * @return     0 on success, -1 if len is larger than VMAC_MTU_MAX or on error.
+ * NOTE: blocks until frame's airtime is available if publication is paced (vmac_pub_pace)
+ */
+int vmac_pub_send_seq(struct vmac_pub *pub, const char *buf, uint16_t len, uint16_t seq)
+{
+	char hdr[VMAC_TXHDR];
+	struct iovec iov[3];
+	if (len > VMAC_MTU_MAX)
+	{
+		return -1;
+	}
+	if (pub->ns_per_byte > 0)
+	{
+		pace(pub, len);
+	}
+	memcpy(hdr, pub->hdr, pub->hlen);
+	memcpy(hdr + pub->seq_off, &seq, sizeof(uint16_t));
+	pub->seq = seq + 1;
+	return tx_send(iov, tx_fill(hdr, pub->hlen, buf, len, iov));
+}
+
+/**
+ * @brief      Sends the next frame of a publication (sequence numbers counted by the handle)
+ *
+ * @return     0 on success, -1 if len is larger than VMAC_MTU_MAX or on error.
+ */
+int vmac_pub_send(struct vmac_pub *pub, const char *buf, uint16_t len)
+{
+	return vmac_pub_send_seq(pub, buf, len, pub->seq);
+}
+
+/**
+ * @brief      Frees handle of vmac_pub_open
+ */
+void vmac_pub_close(struct vmac_pub *pub)
+{
+	free(pub);
+}
+
+/**
+ * @brief      Sends up to VMAC_BATCH_MAX frames in one system call (sendmmsg)
+ *
+ * @param      frames  The frames
+ * @param      metas   meta data of each frame
+ * @param[in]  n       number of frames
+ *
+ * @return     number of frames sent (fewer than n if socket buffer is full with
+ * MSG_DONTWAIT semantics of a non-blocking socket), -1 on error.
+ */
+int vmac_send_batch(struct vmac_frame *frames, struct meta_data *metas, int n)
+{
+	char hdr[VMAC_BATCH_MAX][VMAC_TXHDR];
+	struct iovec iov[VMAC_BATCH_MAX][3];
+	struct mmsghdr msg[VMAC_BATCH_MAX];
+	int i, cnt;
+	if (n > VMAC_BATCH_MAX)
+	{
+		n = VMAC_BATCH_MAX;
+	}
+	memset(msg, 0, n * sizeof(struct mmsghdr));
+	for (i = 0; i < n; i++)
+	{
+		cnt = tx_msg(hdr[i], iov[i], &frames[i], &metas[i]);
+		if (cnt < 0)
+		{
+			break;
+		}
+		msg[i].msg_hdr.msg_name = (void*)&vmac_priv.dest_addr;
+		msg[i].msg_hdr.msg_namelen = sizeof(vmac_priv.dest_addr);
+		msg[i].msg_hdr.msg_iov = iov[i];
+		msg[i].msg_hdr.msg_iovlen = cnt;
+	}
+	if (i == 0)
+	{
+		return n == 0 ? 0 : -1;
+	}
+	return sendmmsg(vmac_priv.sock_fd, msg, i, 0);
+}
+
+/**
+ * @brief      Receives up to VMAC_BATCH_MAX frames without blocking (recvmmsg).
+ * Frames and buffers are borrowed as with vmac_register_borrowed, valid until
+ * the next call. Objects (object mode) go to the object callback, at most
+ * MAX_PAYLOAD bytes in this mode.
+ *
+ * @param      frames  filled frames
+ * @param      metas   meta data of each frame
+ * @param[in]  n       size of frames and metas
+ *
+ * @return     number of frames filled, 0 if none is pending, -1 on error.
+ */
+int vmac_recv_batch(struct vmac_frame *frames, struct meta_data *metas, int n)
+{
+	struct object obj;
+	struct rx_msg rx;
+	int i, got, cnt = 0;
+	if (n > VMAC_BATCH_MAX)
+	{
+		n = VMAC_BATCH_MAX;
+	}
+	if (vmac_priv.rbuf == NULL)
+	{
+		vmac_priv.rbuf = malloc(VMAC_BATCH_MAX * MAX_PAYLOAD);
+		vmac_priv.rmsg = malloc(VMAC_BATCH_MAX * sizeof(struct mmsghdr));
+		if (vmac_priv.rbuf == NULL || vmac_priv.rmsg == NULL)
+		{
+			free(vmac_priv.rbuf);
+			free(vmac_priv.rmsg);
+			vmac_priv.rbuf = NULL;
+			vmac_priv.rmsg = NULL;
+			return -1;
+		}
+		for (i = 0; i < VMAC_BATCH_MAX; i++)
+		{
+			vmac_priv.riov[i].iov_base = vmac_priv.rbuf + i * MAX_PAYLOAD;
+			vmac_priv.riov[i].iov_len = MAX_PAYLOAD;
+		}
+	}
+	memset(vmac_priv.rmsg, 0, n * sizeof(struct mmsghdr));
+	for (i = 0; i < n; i++)
+	{
+		vmac_priv.rmsg[i].msg_hdr.msg_iov = &vmac_priv.riov[i];
+		vmac_priv.rmsg[i].msg_hdr.msg_iovlen = 1;
+	}
+	got = recvmmsg(vmac_priv.sock_fd, vmac_priv.rmsg, n, MSG_DONTWAIT, NULL);
+	if (got < 0)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	}
+	for (i = 0; i < got; i++)
+	{
+		if ((vmac_priv.rmsg[i].msg_hdr.msg_flags & MSG_TRUNC)
+			|| parse_rx((struct nlmsghdr*)vmac_priv.riov[i].iov_base, vmac_priv.rmsg[i].msg_len, &rx) < 0)
+		{
+			continue;
+		}
+		if (rx.type == VMAC_FC_OBJECT && vmac_priv.obj_cb != NULL)
+		{
+			if (rx.len >= sizeof(struct object))
+			{
+				memcpy(&obj, rx.data, sizeof(struct object));
+				(*vmac_priv.obj_cb)(rx.enc, *(uint32_t*)(obj.id), rx.data + sizeof(struct object),
+					*(uint32_t*)(obj.len), *(uint16_t*)(obj.missing), (uint8_t)obj.flags[0]);
+			}
+			continue;
+		}
+		frames[cnt].buf = rx.data;
+		frames[cnt].len = rx.len;
+		name_get(rx.enc, &frames[cnt]);
+		memset(&metas[cnt], 0, sizeof(struct meta_data));
+		metas[cnt].type = rx.type;
+		metas[cnt].seq = rx.seq;
+		metas[cnt].enc = rx.enc;
+		metas[cnt].rate = rx.rate;
+		metas[cnt].bw = rx.bw;
+		metas[cnt].sgi = rx.sgi;
+		cnt++;
+	}
+	return cnt;
+}
+
+/**
+ * @brief      Sets how long kernel keeps state (DACK window, retransmission buffer)
+ * of an idle encoding before freeing it.
+ *
+ * @param      InterestName  The interest name, NULL to set default of all encodings
+ * @param[in]  name_len      The name length
+ * @param[in]  timeout_ms    idle timeout in ms, 0 reverts encoding to default
+ *
+ * @return     0 on success.
+ * NOTE: per encoding timeout applies to state kernel currently holds (i.e. after first interest/data is sent or received)
+ */
+int vmac_set_timeout(char *InterestName, uint16_t name_len, uint32_t timeout_ms)
+{
+	uint64_t enc = 0;
+	if (InterestName != NULL)
+	{
+		enc = name_enc(InterestName, name_len);
+	}
+	return send_config(enc, VMAC_CONFIG_TIMEOUT, timeout_ms);
+}
+
+/**
+ * @brief      Sends one bulk message: netlink header, control, bulk and segment
+ * header (or generic netlink attributes) from a local buffer, object bytes straight from caller's buffer.
+ *
+ * @param[in]  enc   The encoding
+ * @param[in]  buf   The object part
+ * @param[in]  len   The length (at most VMAC_BULK_MAX)
+ * @param      meta  rate, bw, sgi and stream of data frames
+ * @param[in]  mtu   The mtu
+ * @param      sg    segment header of first segment, NULL if not an object
+ *
+ * @return     0 on success.
+ */
+static int send_bulk(uint64_t enc, const char *buf, size_t len, struct meta_data *meta, uint16_t mtu, struct seg *sg)
+{
+	char hdr[NLMSG_HDRLEN + GENL_HDRLEN + 12 * NLA_HDRLEN + 2 * sizeof(uint64_t) + 2 * sizeof(struct seg)]; /* raw or generic netlink headers */
+	struct nlmsghdr *nlh = (struct nlmsghdr*)hdr;
+	size_t hlen = NLMSG_HDRLEN + sizeof(struct control) + sizeof(struct bulk) + (sg ? sizeof(struct seg) : 0);
+	struct control txc;
+	struct bulk bk;
+	struct iovec iov[2];
+	struct msghdr msg;
+	uint8_t type = VMAC_FC_BULK;
+	if (vmac_priv.genl_id)
+	{
+		genl_init(nlh, VMAC_CMD_BULK, vmac_priv.genl_id);
+		genl_put(nlh, VMAC_A_ENC, &enc, sizeof(uint64_t));
+		genl_put(nlh, VMAC_A_RATE, &meta->rate, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_BW, &meta->bw, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_SGI, &meta->sgi, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_STREAM, &meta->stream, sizeof(uint8_t));
+		genl_put(nlh, VMAC_A_MTU, &mtu, sizeof(uint16_t));
+		if (sg != NULL)
+		{
+			genl_put(nlh, VMAC_A_OBJ_ID, &sg->id[0], sizeof(uint32_t));
+			genl_put(nlh, VMAC_A_OBJ_LEN, &sg->len[0], sizeof(uint32_t));
+			genl_put(nlh, VMAC_A_OBJ_IDX, &sg->idx[0], sizeof(uint16_t));
+		}
+		genl_put(nlh, VMAC_A_DATA, NULL, len);
+		return genl_send(vmac_priv.sock_fd, nlh, buf, len);
+	}
+	memset(&txc, 0, sizeof(struct control));
+	memcpy(&txc.type[0], &type, sizeof(uint8_t));
+	memcpy(&txc.enc[0], &enc, sizeof(uint64_t));
+	memcpy(&txc.rate, &meta->rate, sizeof(uint8_t));
 	memcpy(&txc.bw, &meta->bw, sizeof(uint8_t));
 	memcpy(&txc.sgi, &meta->sgi, sizeof(uint8_t));
 	memcpy(&txc.stream, &meta->stream, sizeof(uint8_t));
-	memcpy(NLMSG_DATA(vmac_priv.nlh), &txc, sizeof(struct control));
+	memcpy(&bk.mtu[0], &mtu, sizeof(uint16_t));
+	bk.flags[0] = sg ? VMAC_BULK_OBJECT : 0;
+	memset(nlh, 0, NLMSG_HDRLEN);
+	nlh->nlmsg_len = hlen + len;
+	nlh->nlmsg_type = VMAC_FC_BULK;
+	nlh->nlmsg_pid = vmac_priv.src_addr.nl_pid;
+	memcpy(NLMSG_DATA(nlh), &txc, sizeof(struct control));
+	memcpy(NLMSG_DATA(nlh) + sizeof(struct control), &bk, sizeof(struct bulk));
+	if (sg != NULL)
+	{
+		memcpy(NLMSG_DATA(nlh) + sizeof(struct control) + sizeof(struct bulk), sg, sizeof(struct seg));
+	}
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = hlen;
+	iov[1].iov_base = (void*)buf;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = (void*)&vmac_priv.dest_addr;
+	msg.msg_namelen = sizeof(vmac_priv.dest_addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	if (sendmsg(vmac_priv.sock_fd, &msg, 0) < 0)
+	{
+		return -1;
+	}
+	return 0;
+}
 
-	if (frame->len != 0)
+/**
+ * @brief      data frame payload kernel uses for a requested mtu
+ */
+static uint16_t bulk_mtu(uint16_t mtu)
+{
+	if (mtu == 0)
 	{
-	   memcpy(NLMSG_DATA(vmac_priv.nlh) + sizeof(struct control), frame->buf, frame->len);
+		return VMAC_MTU_DEFAULT;
 	}
+	return mtu > VMAC_MTU_MAX ? VMAC_MTU_MAX : mtu;
+}
 
-	vmac_priv.nlh->nlmsg_len = frame->len + 100;
-    vmac_priv.iov.iov_len = frame->len + 100;
-	sendmsg(vmac_priv.sock_fd, &vmac_priv.msg, 0);
+/**
+ * @brief      bytes per bulk message, a whole number of mtu segments so
+ * only the last data frame of the object is short
+ */
+static size_t bulk_span(uint16_t mtu)
+{
+	mtu = bulk_mtu(mtu);
+	return (VMAC_BULK_MAX / mtu) * mtu;
+}
+
+/**
+ * @brief      Publishes a large object under one interest name. Kernel segments
+ * it into data frames of mtu bytes with consecutive sequence numbers, so a
+ * whole object costs one syscall per VMAC_BULK_MAX bytes instead of one per frame.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * @param[in]  buf           The object
+ * @param[in]  len           The object length
+ * @param      meta          rate, bw, sgi and stream of data frames (type and seq ignored)
+ * @param[in]  mtu           payload per data frame, 0 for VMAC_MTU_DEFAULT
+ *
+ * @return     0 on success.
+ */
+int vmac_publish(char *InterestName, uint16_t name_len, const char *buf, size_t len, struct meta_data *meta, uint16_t mtu)
+{
+	uint64_t enc = name_enc(InterestName, name_len);
+	size_t span = bulk_span(mtu), n;
+	while (len > 0)
+	{
+		n = len < span ? len : span;
+		if (send_bulk(enc, buf, n, meta, mtu, NULL) < 0)
+		{
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
 	return 0;
 }
 
 /**
- * @brief      Adds Interest name to userspace hashmap/
+ * @brief      Same as vmac_publish, reading the object from a file descriptor.
  *
  * @param      InterestName  The interest name
  * @param[in]  name_len      The name length
- * NOTE: DEPRACATED
+ * @param[in]  fd            file, socket or pipe to read object from
+ * @param[in]  off           file offset of object, -1 to read from current position (pipes, sockets)
+ * @param[in]  len           The object length
+ * @param      meta          rate, bw, sgi and stream of data frames
+ * @param[in]  mtu           payload per data frame, 0 for VMAC_MTU_DEFAULT
+ *
+ * @return     0 on success, -1 on error or if fd ended before len bytes.
  */
-void add_name(char*InterestName, uint16_t name_len)
+int vmac_publish_fd(char *InterestName, uint16_t name_len, int fd, off_t off, size_t len, struct meta_data *meta, uint16_t mtu)
 {
-	struct hash *s;
-	char *name;
-	HASH_FIND(hh, vmac_priv.names, &vmac_priv.digest64, sizeof(uint64_t),s);
-	vmac_priv.digest64 = siphash24(InterestName, name_len, vmac_priv.key);
-	HASH_FIND(hh, vmac_priv.names, &vmac_priv.digest64, sizeof(uint64_t),s);
-	
-	if(s == NULL)
+	uint64_t enc = name_enc(InterestName, name_len);
+	size_t span = bulk_span(mtu), n, got;
+	ssize_t r;
+	int ret = 0;
+	char *chunk = malloc(span);
+	if (chunk == NULL)
+	{
+		return -1;
+	}
+	while (len > 0 && ret == 0)
+	{
+		n = len < span ? len : span;
+		for (got = 0; got < n; got += r)
+		{
+			r = off < 0 ? read(fd, chunk + got, n - got) : pread(fd, chunk + got, n - got, off + got);
+			if (r <= 0)
+			{
+				break;
+			}
+		}
+		if (got < n || send_bulk(enc, chunk, n, meta, mtu, NULL) < 0)
+		{
+			ret = -1;
+		}
+		if (off >= 0)
+		{
+			off += n;
+		}
+		len -= n;
+	}
+	free(chunk);
+	return ret;
+}
+
+/**
+ * @brief      Publishes an object that consumers in object mode receive whole
+ * (see vmac_set_object_mode). Frames carry a segment header (object id, length,
+ * segment index), consumers not in object mode get them as plain data frames.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * @param[in]  buf           The object
+ * @param[in]  len           The object length (at most 65535 segments)
+ * @param      meta          rate, bw, sgi and stream of data frames
+ * @param[in]  mtu           payload per data frame, 0 for VMAC_MTU_DEFAULT
+ * @param[out] id            object id assigned, may be NULL
+ *
+ * @return     0 on success.
+ */
+int vmac_publish_object(char *InterestName, uint16_t name_len, const char *buf, uint32_t len, struct meta_data *meta, uint16_t mtu, uint32_t *id)
+{
+	uint64_t enc = name_enc(InterestName, name_len);
+	size_t span = bulk_span(mtu), n, off;
+	uint16_t m = bulk_mtu(mtu), idx;
+	uint32_t oid = __atomic_fetch_add(&vmac_priv.obj_id, 1, __ATOMIC_RELAXED);
+	struct seg sg;
+	if (len == 0 || (len + m - 1) / m > UINT16_MAX)
+	{
+		return -1;
+	}
+	memcpy(&sg.id[0], &oid, sizeof(uint32_t));
+	memcpy(&sg.len[0], &len, sizeof(uint32_t));
+	memcpy(&sg.mtu[0], &m, sizeof(uint16_t));
+	for (off = 0; off < len; off += n)
+	{
+		n = len - off < span ? len - off : span;
+		idx = off / m;
+		memcpy(&sg.idx[0], &idx, sizeof(uint16_t));
+		if (send_bulk(enc, buf + off, n, meta, mtu, &sg) < 0)
+		{
+			return -1;
+		}
+	}
+	if (id != NULL)
+	{
+		*id = oid;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Turns object mode of an encoding on or off. In object mode kernel
+ * holds segments of published objects until the object is complete, or
+ * deadline_ms after its first segment, and cb receives it in one call.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * @param[in]  deadline_ms   wait for missing segments, 0 turns object mode off
+ * @param[in]  cb            object callback, buf is only valid during the call
+ *
+ * @return     0 on success.
+ * NOTE: applies to state kernel currently holds, call after the first interest of the encoding was sent
+ */
+int vmac_set_object_mode(char *InterestName, uint16_t name_len, uint32_t deadline_ms,
+	void (*cb)(uint64_t enc, uint32_t id, char *buf, uint32_t len, uint16_t missing, uint8_t flags))
+{
+	uint64_t enc = name_enc(InterestName, name_len);
+	int rcvbuf = VMAC_OBJ_RCVBUF;
+	if (cb != NULL)
 	{
-		name = malloc(name_len);
-		memcpy(name, InterestName, name_len);
-		s = (struct hash*)malloc(sizeof(struct hash));
-		s->id = vmac_priv.digest64;
-		s->name = name;
-		HASH_ADD(hh, vmac_priv.names, id, sizeof(uint64_t),s);
+		vmac_priv.obj_cb = cb;
+		setsockopt(vmac_priv.sock_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
 	}
+	return send_config(enc, VMAC_CONFIG_OBJECT, deadline_ms);
+}
+
+/**
+ * @brief      Turns in-order delivery of an encoding on or off. In in-order mode
+ * kernel holds data frames until the frames before them arrived, so the
+ * callback gets them in sequence order. A missing frame delays the ones after
+ * it at most deadline_ms, then the callback gets a VMAC_FC_GAP frame (struct
+ * gap) and delivery continues. Frames arriving after their gap are dropped.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * @param[in]  deadline_ms   wait for missing frames, 0 turns in-order mode off
+ *
+ * @return     0 on success.
+ * NOTE: applies to state kernel currently holds, call after the first interest of the encoding was sent.
+ * Frames of encodings in object mode are delivered in arrival order.
+ */
+int vmac_set_in_order(char *InterestName, uint16_t name_len, uint32_t deadline_ms)
+{
+	return send_config(name_enc(InterestName, name_len), VMAC_CONFIG_ORDER, deadline_ms);
 }
 
 /**
- * @brief      Delete interest name from userspace hashmap.
+ * @brief      Turns transmit completion reports of an encoding on or off. The
+ * callback then gets VMAC_FC_TXDONE frames (struct txdone) covering runs of
+ * consecutive data frames: how many the adapter took, when, and how long they
+ * waited in the kernel. A report is sent once it covers frames data frames, a
+ * retransmission breaks the run, or a few ms passed since its first frame.
  *
  * @param      InterestName  The interest name
  * @param[in]  name_len      The name length
- * NOTE: DEPRACATED
+ * @param[in]  frames        data frames per report, 1 reports every frame, 0 turns reports off
+ *
+ * @return     0 on success.
+ * NOTE: applies to state kernel currently holds, call after the first data frame of the encoding was sent.
+ * Frames are broadcast without ACK, completion does not mean any consumer received them.
+ */
+int vmac_set_tx_status(char *InterestName, uint16_t name_len, uint16_t frames)
+{
+	return send_config(name_enc(InterestName, name_len), VMAC_CONFIG_TXSTATUS, frames);
+}
+
+/**
+ * @brief      Claims (or gives up) frames of encodings no process on this node
+ * produces or consumes, e.g. overheard frames and announcements. The first
+ * process to register gets them until it exits.
+ *
+ * @param[in]  on    1 to claim, 0 to give up
+ *
+ * @return     0 on success.
+ */
+int vmac_set_default(uint8_t on)
+{
+	return send_config(0, VMAC_CONFIG_DEFAULT, on);
+}
+
+/**
+ * @brief      Reads V-MAC counters (/proc/net/vmac/stats order) over generic netlink
+ *
+ * @param[out] cnt   counters
+ * @param[in]  n     size of cnt
+ *
+ * @return     number of counters read (may be more or fewer than n with other
+ * kernel module versions), -1 on error or if kernel module has no generic netlink family.
+ */
+int vmac_get_stats(uint64_t *cnt, int n)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr*)buf;
+	struct sockaddr_nl addr;
+	struct nlattr *a, *c;
+	int fd, len, rem, crem, got = -1;
+	if (!vmac_priv.genl_id)
+	{
+		return -1;
+	}
+	/* own socket: replies on the registered one would race with the rx thread */
+	fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+	genl_init(nlh, VMAC_CMD_STATS, vmac_priv.genl_id);
+	nlh->nlmsg_pid = 0;
+	if (genl_send(fd, nlh, NULL, 0) < 0 || (len = recv(fd, buf, sizeof(buf), 0)) < 0
+		|| len < (int)NLMSG_LENGTH(GENL_HDRLEN) || nlh->nlmsg_type != vmac_priv.genl_id || nlh->nlmsg_len > (unsigned int)len)
+	{
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	rem = nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	for (a = (struct nlattr*)((char*)NLMSG_DATA(nlh) + GENL_HDRLEN); rem >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= rem;
+		rem -= NLA_ALIGN(a->nla_len), a = (struct nlattr*)((char*)a + NLA_ALIGN(a->nla_len)))
+	{
+		if ((a->nla_type & NLA_TYPE_MASK) != VMAC_A_STATS)
+		{
+			continue;
+		}
+		got = 0;
+		for (c = (struct nlattr*)((char*)a + NLA_HDRLEN), crem = a->nla_len - NLA_HDRLEN; crem >= NLA_HDRLEN && c->nla_len >= NLA_HDRLEN && c->nla_len <= crem;
+			crem -= NLA_ALIGN(c->nla_len), c = (struct nlattr*)((char*)c + NLA_ALIGN(c->nla_len)))
+		{
+			if (c->nla_type >= 1 && c->nla_type <= n && c->nla_len == NLA_HDRLEN + sizeof(uint64_t))
+			{
+				memcpy(&cnt[c->nla_type - 1], (char*)c + NLA_HDRLEN, sizeof(uint64_t));
+			}
+			if (c->nla_type > got)
+			{
+				got = c->nla_type;
+			}
+		}
+	}
+	return got;
+}
+
+/**
+ * @brief      Records interest name so received frames of its encoding carry
+ * it (frame InterestName). Sending, publishing or configuring a name records
+ * it too.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ */
+void add_name(char*InterestName, uint16_t name_len)
+{
+	name_enc(InterestName, name_len);
+}
+
+/**
+ * @brief      Forgets interest name, received frames of its encoding come
+ * without name again.
+ *
+ * @param      InterestName  The interest name
+ * @param[in]  name_len      The name length
+ * NOTE: frames delivered earlier point to the name, do not call while they are in use
  */
 void del_name(char *InterestName, uint16_t name_len)
 {
 	struct hash *s;
-	char *name;
-	vmac_priv.digest64 = siphash24(InterestName, name_len, vmac_priv.key);
-	HASH_FIND(hh, vmac_priv.names, &vmac_priv.digest64, sizeof(uint64_t), s);
-
+	uint64_t enc = siphash24(InterestName, name_len, vmac_priv.key);
+	pthread_rwlock_wrlock(&vmac_priv.names_lock);
+	HASH_FIND(hh, vmac_priv.names, &enc, sizeof(uint64_t), s);
 	if (s != NULL)
 	{
 		HASH_DEL(vmac_priv.names, s);
+		free(s->name);
 		free(s);
 	}
+	pthread_rwlock_unlock(&vmac_priv.names_lock);
 }
@@ -11,11 +11,15 @@
 * work. If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
 * 
 */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* recvmmsg, sendmmsg */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <linux/netlink.h>
+#include <linux/genetlink.h>
 #include <syslog.h>
 #include <pthread.h>
 #include <setjmp.h>
@@ -24,6 +28,8 @@
 #include <assert.h>
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
 #include "uthash.h"
 
 /** Defines **/
@@ -32,16 +38,85 @@
 
 #define SGI			    0x40
 #define HT40       		0x80
+#define VMAC_RATE_AUTO	255		/* meta_data.rate value: kernel picks rate from DACK loss */
 /* frame types */
 #define VMAC_FC_INT 	0x00    /* Interest frame     */
 #define VMAC_FC_DATA 	0x01	/* Data frame 		  */
 #define VMAC_FC_ANN		0x03	/* Announcement frame */
 #define VMAC_FC_INJ		0x05	/* Injected frame 	  */
+#define VMAC_FC_CONFIG	253		/* Module configuration (not sent over the air) */
+#define VMAC_FC_PRESSURE	252		/* Retransmission memory pressure event, frame buf holds struct pressure */
+#define VMAC_FC_BULK	251		/* Bulk publication segmented into data frames by kernel (see vmac_publish) */
+#define VMAC_FC_OBJECT	250		/* Reassembled object (object mode), passed to object callback */
+#define VMAC_FC_GAP	249		/* In-order mode skipped frames, frame buf holds struct gap */
+#define VMAC_FC_TXDONE	248		/* Transmit completion report, frame buf holds struct txdone */
+
+/* configuration keys (struct config) */
+#define VMAC_CONFIG_TIMEOUT	0x00	/* idle timeout of encoding in ms */
+#define VMAC_CONFIG_OBJECT	0x01	/* object mode deadline of encoding in ms, 0 = off */
+#define VMAC_CONFIG_DEFAULT	0x02	/* nonzero: frames of encodings no process claimed go to this process */
+#define VMAC_CONFIG_ORDER	0x03	/* in-order delivery deadline of encoding in ms, 0 = off */
+#define VMAC_CONFIG_TXSTATUS	0x04	/* data frames per transmit completion report of encoding, 0 = off */
+
+/* bulk flags (struct bulk) */
+#define VMAC_BULK_OBJECT	0x01	/* struct seg follows struct bulk, frames carry object segment header */
+
+/* object flags (object callback) */
+#define VMAC_OBJ_PARTIAL	0x01	/* deadline passed before all segments arrived, missing ones are zero filled */
 
 /* netlink parameters */
 #define VMAC_USER 		29	 /* netlink ID to communicate with V-MAC Kernel Module */
-#define MAX_PAYLOAD  	0x7D0    /* 2KB max payload per-frame */
+#define MAX_PAYLOAD  	0x3000   /* 12KB max payload per-frame (VMAC_MTU_MAX plus headers) */
+#define VMAC_BULK_MAX	0xF000	 /* object bytes per bulk netlink message (below default socket send buffer) */
+#define VMAC_MPDU_MAX	11454	 /* VHT MPDU limit, 802.11 header and FCS included */
+#define VMAC_MTU_MAX	11397	 /* largest data frame payload (VMAC_MPDU_MAX less 802.11, V-MAC and segment headers and FCS) */
+#define VMAC_MTU_DEFAULT	1024	 /* data frame payload of bulk publications when mtu is 0 */
+#define VMAC_TXHDR	128	 /* netlink headers of one frame (raw or generic netlink) */
+#define VMAC_BATCH_MAX	32	 /* frames per vmac_recv_batch/vmac_send_batch call */
+#define VMAC_PACE_PHY	-1.0	 /* vmac_pub_pace: pace at PHY rate of handle */
+#define VMAC_PACE_FRAME_NS	140000	 /* airtime besides MPDU at VMAC_PACE_PHY: VHT preamble, DIFS, average backoff */
+#define VMAC_PACE_BURST_NS	2000000	 /* credit an idle paced publication keeps (burst after pause) */
+#define VMAC_OBJ_RCVBUF	0x400000 /* socket receive buffer requested in object mode (capped by net.core.rmem_max) */
+
 
+/* generic netlink family (used when kernel module has it, raw netlink VMAC_USER otherwise) */
+#define VMAC_GENL_NAME	"vmac"
+#define VMAC_GENL_VERSION	1
+#define VMAC_GENL_MCGRP_EVENTS	"events"
+
+/* ABI commands and attributes of generic netlink family, see kernel/core/genl.h */
+enum {
+	VMAC_CMD_UNSPEC,
+	VMAC_CMD_REGISTER,
+	VMAC_CMD_TX,
+	VMAC_CMD_BULK,
+	VMAC_CMD_CONFIG,
+	VMAC_CMD_STATS,
+	VMAC_CMD_RX,
+	VMAC_CMD_EVENT,
+};
+
+enum {
+	VMAC_A_UNSPEC,
+	VMAC_A_PAD,
+	VMAC_A_ENC,
+	VMAC_A_TYPE,
+	VMAC_A_SEQ,
+	VMAC_A_RATE,
+	VMAC_A_BW,
+	VMAC_A_SGI,
+	VMAC_A_STREAM,
+	VMAC_A_DATA,
+	VMAC_A_CONFIG_KEY,
+	VMAC_A_CONFIG_VAL,
+	VMAC_A_MTU,
+	VMAC_A_OBJ_ID,
+	VMAC_A_OBJ_LEN,
+	VMAC_A_OBJ_IDX,
+	VMAC_A_SIGNAL,
+	VMAC_A_TSTAMP,
+	VMAC_A_STATS,
+};
 
 /** Structs **/
 const static struct {
@@ -181,10 +256,127 @@ struct control{
     char stream;
 };
 
+/**
+ ** ABI follows struct control in VMAC_FC_CONFIG messages.
+**/
+struct config{
+    char key[1];
+    char val[4];
+};
+
+/**
+ ** ABI buffer of VMAC_FC_PRESSURE events, meta enc is last encoding whose
+ ** buffered frames were evicted (0 if none).
+**/
+struct pressure{
+    char used_kb[4];
+    char budget_kb[4];
+    char evicted[4];
+};
+
+/**
+ ** ABI buffer of VMAC_FC_GAP events: in-order delivery of meta enc gave up
+ ** on count frames starting at sequence first.
+**/
+struct gap{
+    char first[2];
+    char count[2];
+};
+
+/**
+ ** ABI buffer of VMAC_FC_TXDONE events: count data frames of meta enc from
+ ** sequence first were handed to the adapter, failed of them were not.
+ ** Delays (us) run from the kernel taking the frame to completion.
+**/
+struct txdone{
+    char first[2];
+    char count[2];
+    char failed[2];
+    char tstamp[8]; /* completion of last frame, ns since epoch */
+    char delay_avg[4];
+    char delay_max[4];
+};
+
+/**
+ ** ABI follows struct control in VMAC_FC_BULK messages, object bytes follow.
+**/
+struct bulk{
+    char mtu[2];
+    char flags[1];
+};
+
+/**
+ ** ABI follows struct bulk if flags has VMAC_BULK_OBJECT: segment index
+ ** of first byte of the message within object id of len bytes.
+**/
+struct seg{
+    char id[4];
+    char len[4];
+    char mtu[2];
+    char idx[2];
+};
+
+/**
+ ** ABI follows struct control in VMAC_FC_OBJECT messages, object follows.
+**/
+struct object{
+    char id[4];
+    char len[4];
+    char missing[2];
+    char flags[1];
+};
+
+/**
+ * @brief      message of kernel module, from raw or generic netlink
+ */
+struct rx_msg
+{
+	uint8_t type;
+	uint16_t seq;
+	uint8_t rate;
+	uint8_t bw;
+	uint8_t sgi;
+	uint64_t enc;
+	char *data;
+	size_t len;
+};
+
+/**
+ * @brief      receive buffer with the frame and meta data passed to a borrowed
+ * callback (vmac_register_borrowed), pooled while retained frames are released
+ */
+struct vmac_rxbuf
+{
+	struct vmac_frame frame; /* first: vmac_release finds buffer from frame */
+	struct meta_data meta;
+	struct vmac_rxbuf *next; /* pool */
+	struct nlmsghdr *nlh;
+	size_t size;
+};
+
+/**
+ * @brief      publication handle (vmac_pub_open): encoding and netlink headers
+ * of its frames, built once
+ */
+struct vmac_pub
+{
+	uint64_t enc;
+	uint16_t seq; /* sequence of next vmac_pub_send */
+	uint8_t rate, bw, sgi, stream;
+	/* pacing (vmac_pub_pace) */
+	double ns_per_byte; /* airtime per byte on air, 0 = not paced */
+	uint64_t frame_ns; /* airtime per frame besides bytes */
+	uint64_t next; /* CLOCK_MONOTONIC ns from which next frame may be sent */
+	size_t hlen;
+	size_t seq_off; /* sequence number within hdr */
+	char hdr[VMAC_TXHDR];
+};
+
 /* Struct to hash interest name to 64-bit encoding */
 struct hash{
 	uint64_t id;
 	char *name;
+	uint16_t name_len;
 	UT_hash_handle hh;
 };
 
@@ -194,9 +386,10 @@ struct hash{
  */
 struct vmac_lib_priv
 {
-	struct hash* names;
+	struct hash* names; /* encoding to interest name of names this process used */
+	pthread_rwlock_t names_lock; /* names */
 	struct sockaddr_nl src_addr,dest_addr;
-	/* TX structs */
+	/* TX structs (registration only, frames and configuration are built on the sender's stack) */
 	struct nlmsghdr *nlh;
 	struct iovec iov;
 	struct msghdr msg;
@@ -209,8 +402,21 @@ struct vmac_lib_priv
 	uint64_t digest64; 
 	uint8_t fixed_rate;
 	void (*cb)();
+	void (*obj_cb)(uint64_t enc, uint32_t id, char *buf, uint32_t len, uint16_t missing, uint8_t flags);
+	void (*borrow_cb)(struct vmac_frame *frame, struct meta_data *meta);
+	size_t rxsize; /* size of receive buffer nlh2 */
+	struct vmac_rxbuf *rxb; /* frame and meta of borrowed callback, receive buffer nlh2 */
+	struct vmac_rxbuf *rx_free; /* pool of receive buffers released by application */
+	pthread_mutex_t rx_lock; /* rx_free */
+	uint8_t retained; /* borrowed callback retained frame */
+	/* vmac_recv_batch structs */
+	char *rbuf; /* VMAC_BATCH_MAX buffers of MAX_PAYLOAD */
+	struct iovec riov[VMAC_BATCH_MAX];
+	struct mmsghdr *rmsg; /* VMAC_BATCH_MAX */
+	uint32_t obj_id; /* id of next published object */
 	char msgy[2000]; /* buffer to store frame */
 	int sock_fd;
+	uint16_t genl_id; /* generic netlink family id, 0 = raw netlink */
 	pthread_t thread;
 	char key[16];	
 };
@@ -223,3 +429,25 @@ int send_vmac(struct vmac_frame *frame, struct meta_data *meta);
 void add_name(char*InterestName, uint16_t name_len);
 void del_name(char *InterestName, uint16_t name_len);
 int vmac_register(void (*cf));
+int vmac_register_borrowed(void (*cb)(struct vmac_frame *frame, struct meta_data *meta));
+int vmac_retain(struct vmac_frame *frame);
+void vmac_release(struct vmac_frame *frame);
+int vmac_open(void);
+int vmac_recv_batch(struct vmac_frame *frames, struct meta_data *metas, int n);
+int vmac_send_batch(struct vmac_frame *frames, struct meta_data *metas, int n);
+struct vmac_pub *vmac_pub_open(char *InterestName, uint16_t name_len, struct meta_data *meta);
+int vmac_pub_send(struct vmac_pub *pub, const char *buf, uint16_t len);
+int vmac_pub_send_seq(struct vmac_pub *pub, const char *buf, uint16_t len, uint16_t seq);
+void vmac_pub_close(struct vmac_pub *pub);
+int vmac_pub_pace(struct vmac_pub *pub, double mbps);
+uint64_t vmac_pub_wait_ns(struct vmac_pub *pub);
+int vmac_set_timeout(char *InterestName, uint16_t name_len, uint32_t timeout_ms);
+int vmac_publish(char *InterestName, uint16_t name_len, const char *buf, size_t len, struct meta_data *meta, uint16_t mtu);
+int vmac_publish_fd(char *InterestName, uint16_t name_len, int fd, off_t off, size_t len, struct meta_data *meta, uint16_t mtu);
+int vmac_publish_object(char *InterestName, uint16_t name_len, const char *buf, uint32_t len, struct meta_data *meta, uint16_t mtu, uint32_t *id);
+int vmac_set_default(uint8_t on);
+int vmac_set_in_order(char *InterestName, uint16_t name_len, uint32_t deadline_ms);
+int vmac_set_tx_status(char *InterestName, uint16_t name_len, uint16_t frames);
+int vmac_get_stats(uint64_t *cnt, int n);
+int vmac_set_object_mode(char *InterestName, uint16_t name_len, uint32_t deadline_ms,
+	void (*cb)(uint64_t enc, uint32_t id, char *buf, uint32_t len, uint16_t missing, uint8_t flags));